@@ -0,0 +1,477 @@
+#include <stdexcept>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <chrono>
+#include <sstream>
+#include <fstream>
+#include <filesystem>
+#include <algorithm>
+#include <iterator>
+#include <opencv2/imgproc.hpp>
+#include "CascadePlanner.h"
+
+typedef struct
+{
+    CascadePlanner::Preference preference;
+    std::string_view name;
+    double qualityLossTolerance; // Accepted quality loss, relative to the best plan
+} PreferenceDescription;
+
+constexpr std::array<PreferenceDescription, 3> PREFERENCES_DESCRIPTION = {{
+        {CascadePlanner::Preference::SPEED, "speed", 1.5},
+        {CascadePlanner::Preference::BALANCED, "balanced", 1.25},
+        {CascadePlanner::Preference::QUALITY, "quality", 1.0}
+}};
+
+constexpr std::array<SuperRes::Algo, 5> PLANNED_ALGOS = {SuperRes::Algo::ESPCN, SuperRes::Algo::FSRCNN,
+                                                         SuperRes::Algo::FSRCNN_SMALL, SuperRes::Algo::LapSRN,
+                                                         SuperRes::Algo::EDSR};
+constexpr unsigned short MAX_MODEL_SCALE = 8;
+
+// Quality loss per octave of upscale, roughly following the published PSNR ranking of the models
+constexpr double EDSR_OCTAVE_LOSS = 0.6;
+constexpr double LAPSRN_OCTAVE_LOSS = 0.85;
+constexpr double FSRCNN_OCTAVE_LOSS = 0.9;
+constexpr double ESPCN_OCTAVE_LOSS = 1.0;
+constexpr double FSRCNN_SMALL_OCTAVE_LOSS = 1.1;
+constexpr double CHAINED_STAGE_LOSS = 0.25; // Each model after the first one also upscales previous artifacts
+constexpr double RESIZE_UPSCALE_OCTAVE_LOSS = 2.0; // Interpolation doesn't create any detail
+constexpr double RESIZE_DOWNSCALE_OCTAVE_LOSS = 0.1;
+
+constexpr double MAX_NETWORK_OVERSHOOT = 2.0; // Models may upscale more than requested, then the resize shrinks
+constexpr double REMAINDER_EPSILON = 1e-6;
+constexpr size_t TIMING_RUNS_NUMBER = 3; // Fastest run is kept, others are disturbed by the rest of the system
+constexpr size_t ROUGH_TIMING_RUNS_NUMBER = 1;
+constexpr int ROUGH_PROBE_DIVISOR = 4; // Rough timings run on a probe 16 times smaller
+constexpr double ROUGH_TIMING_MARGIN = 2.0; // Plans roughly costlier than the cheapest one by this factor are dismissed
+constexpr double MAX_TIMING_RUN_SECONDS = 0.5; // Probe is shrunk for slow models, they are busy enough on less pixels
+constexpr std::string_view RESIZE_TIMING_NAME = "resize";
+constexpr std::string_view ROUGH_TIMING_QUALIFIER = "rough";
+
+static const PreferenceDescription &GetPreferenceDescription(CascadePlanner::Preference preference)
+{
+    for (const PreferenceDescription &preferenceDescription: PREFERENCES_DESCRIPTION)
+    {
+        if (preferenceDescription.preference == preference)
+        {
+            return preferenceDescription;
+        }
+    }
+    throw std::invalid_argument("Unknown preference");
+}
+
+template<typename Function>
+static double MeasureFastestRun(Function function, size_t runsNumber = TIMING_RUNS_NUMBER)
+{
+    double fastestRun = std::numeric_limits<double>::max();
+    for (size_t i = 0; i < runsNumber; ++i)
+    {
+        auto runBeginTime = std::chrono::steady_clock::now();
+        function();
+        std::chrono::duration<double> runDuration = std::chrono::steady_clock::now() - runBeginTime;
+        fastestRun = std::min(fastestRun, runDuration.count());
+    }
+    return fastestRun;
+}
+
+template<typename Predicate>
+static std::vector<CascadePlanner::Stage> GetPlansModels(const std::vector<CascadePlanner::Plan> &plans,
+                                                         Predicate predicate)
+{
+    std::vector<CascadePlanner::Stage> models; // Each model once
+    for (const CascadePlanner::Plan &candidatePlan: plans)
+    {
+        for (const CascadePlanner::Stage &stage: candidatePlan.stages)
+        {
+            if (predicate(stage) &&
+                std::none_of(models.begin(), models.end(), [&stage](const CascadePlanner::Stage &model) -> bool {
+                    return model.algo == stage.algo && model.scale == stage.scale;
+                }))
+            {
+                models.push_back(stage);
+            }
+        }
+    }
+    return models;
+}
+
+CascadePlanner::CascadePlanner(std::string_view modelsPath) : _modelsPath(modelsPath)
+{
+    if (!std::filesystem::is_directory(_modelsPath))
+    {
+        throw std::invalid_argument("Cannot access " + _modelsPath);
+    }
+    for (SuperRes::Algo algo: PLANNED_ALGOS)
+    {
+        for (unsigned short scale = 2; scale <= MAX_MODEL_SCALE; ++scale)
+        {
+            if (SuperRes::IsScaleSupported(algo, scale) &&
+                std::filesystem::exists(SuperRes::GetModelPath(_modelsPath, algo, scale)))
+            {
+                _availableModels.push_back(Stage{algo, scale});
+            }
+        }
+    }
+}
+
+CascadePlanner::Plan CascadePlanner::plan(double upscaleFactor, Preference preference)
+{
+    std::vector<Plan> plans = estimatePlans(upscaleFactor);
+    double bestQualityLoss = std::numeric_limits<double>::max();
+    for (const Plan &candidatePlan: plans)
+    {
+        bestQualityLoss = std::min(bestQualityLoss, candidatePlan.qualityLoss);
+    }
+    // Quality doesn't depend on timings, so models of plans that cannot be chosen are never timed
+    const double maxQualityLoss =
+            bestQualityLoss * GetPreferenceDescription(preference).qualityLossTolerance + REMAINDER_EPSILON;
+    plans.erase(std::remove_if(plans.begin(), plans.end(), [maxQualityLoss](const Plan &candidatePlan) -> bool {
+        return candidatePlan.qualityLoss > maxQualityLoss;
+    }), plans.end());
+    // A single plan good enough wins whatever its cost, but chains still need their stages costs to share instances
+    if (plans.size() > 1 || plans.front().stages.size() > 1)
+    {
+        measureMissingTimings(plans);
+    }
+    // Cheapest plan among the ones that are good enough
+    const Plan *chosenPlan = nullptr;
+    for (const Plan &candidatePlan: plans)
+    {
+        if (chosenPlan == nullptr || candidatePlan.cost < chosenPlan->cost ||
+            (candidatePlan.cost == chosenPlan->cost && candidatePlan.qualityLoss < chosenPlan->qualityLoss))
+        {
+            chosenPlan = &candidatePlan;
+        }
+    }
+    return *chosenPlan; // Best plan is always kept
+}
+
+std::vector<CascadePlanner::Plan> CascadePlanner::listPlans(double upscaleFactor)
+{
+    std::vector<Plan> plans = estimatePlans(upscaleFactor);
+    measureMissingTimings(plans);
+    return plans;
+}
+
+void CascadePlanner::measureModelTimings(const cv::Size &probeSize)
+{
+    measureTimings(_availableModels, probeSize, TIMING_RUNS_NUMBER, false);
+}
+
+std::optional<double> CascadePlanner::getModelTiming(const Stage &stage) const
+{
+    auto modelTiming = _modelsTiming.find(GetTimingKey(stage));
+    if (modelTiming == _modelsTiming.end())
+    {
+        return std::nullopt;
+    }
+    return modelTiming->second.secondsPerInputPixel;
+}
+
+void CascadePlanner::setModelTiming(const Stage &stage, double secondsPerInputPixel)
+{
+    _modelsTiming[GetTimingKey(stage)] = ModelTiming{secondsPerInputPixel, false};
+}
+
+bool CascadePlanner::isModelTimingRough(const Stage &stage) const
+{
+    auto modelTiming = _modelsTiming.find(GetTimingKey(stage));
+    return modelTiming != _modelsTiming.end() && modelTiming->second.rough;
+}
+
+bool CascadePlanner::loadTimings(const std::string &timingsFilePath)
+{
+    std::ifstream timingsFile(timingsFilePath);
+    if (!timingsFile)
+    {
+        return false;
+    }
+    std::string line;
+    while (std::getline(timingsFile, line)) // One "<model name> <seconds per pixel> [rough]" per line
+    {
+        std::istringstream lineStream(line);
+        std::string name, qualifier;
+        double timing = 0.0;
+        if (!(lineStream >> name >> timing))
+        {
+            continue;
+        }
+        lineStream >> qualifier;
+        if (name == RESIZE_TIMING_NAME)
+        {
+            _resizeTiming = timing;
+            continue;
+        }
+        for (const Stage &model: _availableModels)
+        {
+            if (SuperRes::GetModelName(model.algo, model.scale) == name)
+            {
+                _modelsTiming[GetTimingKey(model)] = ModelTiming{timing, qualifier == ROUGH_TIMING_QUALIFIER};
+            }
+        }
+    }
+    return true;
+}
+
+void CascadePlanner::saveTimings(const std::string &timingsFilePath) const
+{
+    std::ofstream timingsFile(timingsFilePath, std::ios::trunc);
+    timingsFile.precision(std::numeric_limits<double>::max_digits10);
+    for (const Stage &model: _availableModels)
+    {
+        std::optional<double> modelTiming = getModelTiming(model);
+        if (modelTiming.has_value())
+        {
+            timingsFile << SuperRes::GetModelName(model.algo, model.scale) << " " << modelTiming.value();
+            if (isModelTimingRough(model))
+            {
+                timingsFile << " " << ROUGH_TIMING_QUALIFIER;
+            }
+            timingsFile << std::endl;
+        }
+    }
+    if (_resizeTiming.has_value())
+    {
+        timingsFile << RESIZE_TIMING_NAME << " " << _resizeTiming.value() << std::endl;
+    }
+    if (!timingsFile)
+    {
+        throw std::runtime_error("Cannot write " + timingsFilePath);
+    }
+}
+
+const std::vector<CascadePlanner::Stage> &CascadePlanner::getAvailableModels() const
+{
+    return _availableModels;
+}
+
+cv::Size CascadePlanner::GetOutputSize(const Plan &plan, const cv::Size &inputSize)
+{
+    if (std::abs(plan.remainderFactor - 1.0) < REMAINDER_EPSILON) // Exactly the last model output
+    {
+        cv::Size outputSize = inputSize;
+        for (const Stage &stage: plan.stages)
+        {
+            outputSize = cv::Size(outputSize.width * stage.scale, outputSize.height * stage.scale);
+        }
+        return outputSize;
+    }
+    return {2 * (int) std::lround((double) inputSize.width * plan.upscaleFactor / 2.0),
+            2 * (int) std::lround((double) inputSize.height * plan.upscaleFactor / 2.0)};
+}
+
+std::string CascadePlanner::GetPlanDescription(const Plan &plan)
+{
+    std::ostringstream description;
+    for (const Stage &stage: plan.stages)
+    {
+        description << (description.tellp() > 0 ? " -> " : "") << SuperRes::GetModelName(stage.algo, stage.scale);
+    }
+    if (std::abs(plan.remainderFactor - 1.0) >= REMAINDER_EPSILON)
+    {
+        description << (description.tellp() > 0 ? " -> " : "") << "resize x" << plan.remainderFactor;
+    }
+    if (description.tellp() == 0)
+    {
+        description << "none";
+    }
+    return description.str();
+}
+
+std::optional<CascadePlanner::Preference> CascadePlanner::ParsePreference(std::string_view preferenceName)
+{
+    for (const PreferenceDescription &preferenceDescription: PREFERENCES_DESCRIPTION)
+    {
+        if (preferenceDescription.name == preferenceName)
+        {
+            return preferenceDescription.preference;
+        }
+    }
+    return std::nullopt;
+}
+
+std::string_view CascadePlanner::GetPreferenceName(Preference preference)
+{
+    return GetPreferenceDescription(preference).name;
+}
+
+std::vector<CascadePlanner::Plan> CascadePlanner::estimatePlans(double upscaleFactor) const
+{
+    if (!(upscaleFactor >= 1.0 && upscaleFactor <= MAX_UPSCALE_FACTOR))
+    {
+        throw std::invalid_argument("Upscale factor must be between 1 and " + std::to_string((int) MAX_UPSCALE_FACTOR));
+    }
+    std::vector<Plan> plans;
+    std::vector<Stage> stages;
+    addPlans(upscaleFactor, stages, 1.0, plans);
+    return plans;
+}
+
+void CascadePlanner::measureMissingTimings(std::vector<Plan> &plans)
+{
+    const cv::Size probeSize(DEFAULT_PROBE_WIDTH, DEFAULT_PROBE_HEIGHT);
+    if (!_resizeTiming.has_value())
+    {
+        measureResizeTiming(probeSize);
+    }
+    // Every untimed model is first timed roughly, slow models only take a few seconds this way
+    std::vector<Stage> untimedModels = GetPlansModels(plans, [this](const Stage &model) -> bool {
+        return !getModelTiming(model).has_value();
+    });
+    const cv::Size roughProbeSize(probeSize.width / ROUGH_PROBE_DIVISOR, probeSize.height / ROUGH_PROBE_DIVISOR);
+    measureTimings(untimedModels, roughProbeSize, ROUGH_TIMING_RUNS_NUMBER, true);
+    if (plans.size() < 2) // Rough costs are enough to share instances between the stages of a single plan
+    {
+        for (Plan &candidatePlan: plans)
+        {
+            candidatePlan = estimatePlan(candidatePlan.upscaleFactor, candidatePlan.stages);
+        }
+        return;
+    }
+    while (true) // Then precisely, until every plan that may be the cheapest one has precise costs
+    {
+        double cheapestCost = std::numeric_limits<double>::max();
+        for (Plan &candidatePlan: plans) // Estimated with the timings known at the time
+        {
+            candidatePlan = estimatePlan(candidatePlan.upscaleFactor, candidatePlan.stages);
+            cheapestCost = std::min(cheapestCost, candidatePlan.cost);
+        }
+        std::vector<Plan> competitivePlans;
+        std::copy_if(plans.begin(), plans.end(), std::back_inserter(competitivePlans),
+                     [cheapestCost](const Plan &candidatePlan) -> bool {
+                         return candidatePlan.cost <= cheapestCost * ROUGH_TIMING_MARGIN;
+                     });
+        std::vector<Stage> roughModels = GetPlansModels(competitivePlans, [this](const Stage &model) -> bool {
+            return isModelTimingRough(model);
+        });
+        if (roughModels.empty())
+        {
+            return;
+        }
+        for (const Stage &model: roughModels)
+        {
+            const double roughRunSeconds = getModelTiming(model).value() * (double) probeSize.area();
+            const double probeScale = std::clamp(std::sqrt(MAX_TIMING_RUN_SECONDS / roughRunSeconds),
+                                                 1.0 / ROUGH_PROBE_DIVISOR, 1.0);
+            measureTimings({model}, cv::Size((int) std::lround(probeSize.width * probeScale),
+                                             (int) std::lround(probeSize.height * probeScale)),
+                           TIMING_RUNS_NUMBER, false);
+        }
+    }
+}
+
+void CascadePlanner::measureTimings(const std::vector<Stage> &models, const cv::Size &probeSize, size_t runsNumber,
+                                    bool rough)
+{
+    const cv::Mat probeFrame(probeSize, CV_8UC3, cv::Scalar::all(128));
+    cv::Mat probeOutput;
+    for (const Stage &model: models)
+    {
+        if (getModelTiming(model).has_value() && !isModelTimingRough(model))
+        {
+            continue;
+        }
+        SuperRes superRes(_modelsPath, model.algo, model.scale);
+        superRes.upRes(probeFrame, probeOutput); // Network setup is not part of the steady state cost
+        double fastestRun = MeasureFastestRun([&]() {
+            superRes.upRes(probeFrame, probeOutput);
+        }, runsNumber);
+        _modelsTiming[GetTimingKey(model)] = ModelTiming{fastestRun / (double) probeFrame.total(), rough};
+    }
+    if (!_resizeTiming.has_value())
+    {
+        measureResizeTiming(probeSize);
+    }
+}
+
+void CascadePlanner::measureResizeTiming(const cv::Size &probeSize)
+{
+    const cv::Mat probeFrame(probeSize, CV_8UC3, cv::Scalar::all(128));
+    const cv::Size resizedSize(probeSize.width * 2, probeSize.height * 2);
+    cv::Mat probeOutput;
+    double fastestRun = MeasureFastestRun([&]() {
+        cv::resize(probeFrame, probeOutput, resizedSize, 0, 0, cv::INTER_CUBIC);
+    });
+    _resizeTiming = fastestRun / (double) resizedSize.area();
+}
+
+void CascadePlanner::addPlans(double upscaleFactor, std::vector<Stage> &stages, double networkScale,
+                              std::vector<Plan> &plans) const
+{
+    if (networkScale > upscaleFactor * MAX_NETWORK_OVERSHOOT + REMAINDER_EPSILON)
+    {
+        return;
+    }
+    plans.push_back(estimatePlan(upscaleFactor, stages));
+    if (networkScale >= upscaleFactor - REMAINDER_EPSILON || stages.size() >= MAX_CASCADE_STAGES)
+    {
+        return;
+    }
+    for (const Stage &model: _availableModels)
+    {
+        stages.push_back(model);
+        addPlans(upscaleFactor, stages, networkScale * model.scale, plans);
+        stages.pop_back();
+    }
+}
+
+CascadePlanner::Plan CascadePlanner::estimatePlan(double upscaleFactor, const std::vector<Stage> &stages) const
+{
+    double networkScale = 1.0;
+    for (const Stage &stage: stages)
+    {
+        networkScale *= stage.scale;
+    }
+    Plan estimatedPlan{.upscaleFactor = upscaleFactor, .stages = stages, .stagesCost = {},
+                       .remainderFactor = upscaleFactor / networkScale, .cost = 0.0, .qualityLoss = 0.0};
+    double stageInputPixels = 1.0; // Per cascade input pixel
+    for (const Stage &stage: stages)
+    {
+        estimatedPlan.stagesCost.push_back(getModelTiming(stage).value_or(0.0) * stageInputPixels);
+        estimatedPlan.cost += estimatedPlan.stagesCost.back();
+        estimatedPlan.qualityLoss += GetStageQualityLoss(stage);
+        stageInputPixels *= (double) stage.scale * stage.scale;
+    }
+    if (stages.size() > 1)
+    {
+        estimatedPlan.qualityLoss += CHAINED_STAGE_LOSS * (double) (stages.size() - 1);
+    }
+    if (std::abs(estimatedPlan.remainderFactor - 1.0) >= REMAINDER_EPSILON)
+    {
+        estimatedPlan.cost += _resizeTiming.value_or(0.0) * upscaleFactor * upscaleFactor;
+        double remainderOctaves = std::log2(estimatedPlan.remainderFactor);
+        estimatedPlan.qualityLoss += remainderOctaves > 0.0 ? RESIZE_UPSCALE_OCTAVE_LOSS * remainderOctaves :
+                                     -RESIZE_DOWNSCALE_OCTAVE_LOSS * remainderOctaves;
+    }
+    return estimatedPlan;
+}
+
+double CascadePlanner::GetStageQualityLoss(const Stage &stage)
+{
+    double octaveLoss = ESPCN_OCTAVE_LOSS;
+    switch (stage.algo)
+    {
+        case SuperRes::Algo::EDSR:
+            octaveLoss = EDSR_OCTAVE_LOSS;
+            break;
+        case SuperRes::Algo::FSRCNN:
+            octaveLoss = FSRCNN_OCTAVE_LOSS;
+            break;
+        case SuperRes::Algo::FSRCNN_SMALL:
+            octaveLoss = FSRCNN_SMALL_OCTAVE_LOSS;
+            break;
+        case SuperRes::Algo::LapSRN:
+            octaveLoss = LAPSRN_OCTAVE_LOSS;
+            break;
+        case SuperRes::Algo::ESPCN:
+            octaveLoss = ESPCN_OCTAVE_LOSS;
+            break;
+    }
+    return octaveLoss * std::log2((double) stage.scale);
+}
+
+std::pair<SuperRes::Algo, unsigned short> CascadePlanner::GetTimingKey(const Stage &stage)
+{
+    return {stage.algo, stage.scale};
+}
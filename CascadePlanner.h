@@ -0,0 +1,202 @@
+#ifndef MOVIE_QUALITY_INCREASE_CASCADEPLANNER_H
+#define MOVIE_QUALITY_INCREASE_CASCADEPLANNER_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <map>
+#include <utility>
+#include <optional>
+#include <opencv2/core.hpp>
+#include "SuperRes.h"
+
+class CascadePlanner
+{
+public:
+    enum class Preference
+    {
+        /**
+         * @brief Cheapest plan whose estimated quality is within a wide margin of the best one
+         * @note May leave a large part of the upscale to the final resize
+         */
+        SPEED,
+
+        /**
+         * @brief Cheapest plan whose estimated quality is close to the best one
+         */
+        BALANCED,
+
+        /**
+         * @brief Best estimated quality, cost only breaks ties
+         */
+        QUALITY
+    };
+
+    typedef struct
+    {
+        SuperRes::Algo algo;
+        unsigned short scale;
+    } Stage;
+
+    typedef struct
+    {
+        double upscaleFactor; // Requested upscale factor
+        std::vector<Stage> stages; // Models applied in order, may be empty
+        std::vector<double> stagesCost; // Estimated seconds per cascade input pixel of each stage
+        double remainderFactor; // Resize applied after the models, 1 if none
+        double cost; // Estimated seconds per cascade input pixel, final resize included
+        double qualityLoss; // Heuristic, lower is better
+    } Plan;
+
+    /**
+     * @brief Construct a new CascadePlanner object
+     * @param modelsPath Path to the models folder, only models found there are planned
+     * @throw std::invalid_argument If the models folder doesn't exist
+     */
+    explicit CascadePlanner(std::string_view modelsPath);
+
+    /**
+     * @brief Destroy the CascadePlanner object
+     */
+    ~CascadePlanner() = default;
+
+    /**
+     * @brief Choose the chain of models reaching an upscale factor
+     * @param upscaleFactor Upscale factor, at least 1, may be non-integer
+     * @param preference Trade-off between speed and quality
+     * @return Chosen plan
+     * @throw std::invalid_argument If the upscale factor is lower than 1 or greater than MAX_UPSCALE_FACTOR
+     * @note Only the models of plans whose estimated quality is good enough for the preference are timed, when they
+     * were not timed yet and several plans or a chain of models are good enough. They are first timed roughly on a
+     * small probe, then only the models of plans that may be the cheapest are timed precisely, see
+     * measureModelTimings()
+     */
+    Plan plan(double upscaleFactor, Preference preference);
+
+    /**
+     * @brief List every plan reaching an upscale factor, with its estimated cost and quality
+     * @param upscaleFactor Upscale factor, at least 1, may be non-integer
+     * @return Candidate plans, unsorted
+     * @throw std::invalid_argument If the upscale factor is lower than 1 or greater than MAX_UPSCALE_FACTOR
+     * @note Models of the candidate plans that were not timed yet are measured first, the costs of plans much
+     * costlier than the cheapest one are only rough
+     */
+    std::vector<Plan> listPlans(double upscaleFactor);
+
+    /**
+     * @brief Time every available model that was not timed yet, and the final resize
+     * @param probeSize Size of the probe frame, large enough for the inference target to be busy
+     * @note Each model is loaded and run once before being timed, so that setup is not measured
+     */
+    void measureModelTimings(const cv::Size &probeSize = cv::Size(DEFAULT_PROBE_WIDTH, DEFAULT_PROBE_HEIGHT));
+
+    /**
+     * @brief Get the measured cost of a model
+     * @param stage Model
+     * @return Seconds per input pixel, std::nullopt if the model was not timed
+     */
+    [[nodiscard]] std::optional<double> getModelTiming(const Stage &stage) const;
+
+    /**
+     * @brief Set the cost of a model, for example measured during a previous run
+     * @param stage Model
+     * @param secondsPerInputPixel Inference time divided by the number of input pixels
+     */
+    void setModelTiming(const Stage &stage, double secondsPerInputPixel);
+
+    /**
+     * @brief Load the models and final resize costs saved by a previous run
+     * @param timingsFilePath Path to the file written by saveTimings()
+     * @return False if the file cannot be read, true otherwise
+     * @note Lines of models that are not available anymore and malformed lines are ignored
+     */
+    bool loadTimings(const std::string &timingsFilePath);
+
+    /**
+     * @brief Save the measured models and final resize costs, so that next runs don't time them again
+     * @note Rough costs are saved as such, next runs time them precisely if their plans become competitive
+     * @param timingsFilePath Path to the file, overwritten if it exists
+     * @throw std::runtime_error If the file cannot be written
+     * @note Costs depend on the inference target, so the file must not be shared between machines
+     */
+    void saveTimings(const std::string &timingsFilePath) const;
+
+    /**
+     * @brief Get the models found in the models folder
+     * @return Available models
+     */
+    [[nodiscard]] const std::vector<Stage> &getAvailableModels() const;
+
+    /**
+     * @brief Get the output size of a plan
+     * @param plan Plan
+     * @param inputSize Size of the cascade input
+     * @return Size of the last model output if there is no remainder, else the upscaled size rounded to even,
+     * as needed by 4:2:0 encoders
+     */
+    static cv::Size GetOutputSize(const Plan &plan, const cv::Size &inputSize);
+
+    /**
+     * @brief Describe a plan
+     * @param plan Plan
+     * @return Description, for example "ESPCN_x2 -> ESPCN_x3 -> resize x1.5"
+     */
+    static std::string GetPlanDescription(const Plan &plan);
+
+    /**
+     * @brief Get the preference corresponding to a name
+     * @param preferenceName Preference name: speed, balanced or quality
+     * @return Preference, std::nullopt if the name is unknown
+     */
+    static std::optional<Preference> ParsePreference(std::string_view preferenceName);
+
+    /**
+     * @brief Get the name of a preference
+     * @param preference Preference
+     * @return Preference name, as accepted by ParsePreference()
+     */
+    static std::string_view GetPreferenceName(Preference preference);
+
+    static constexpr Preference DEFAULT_PREFERENCE = Preference::BALANCED;
+
+    static constexpr double MAX_UPSCALE_FACTOR = 16.0; // Already beyond 8K for a SD movie
+
+    static constexpr size_t MAX_CASCADE_STAGES = 3; // Artifacts of each model are amplified by the next ones
+
+    static constexpr int DEFAULT_PROBE_WIDTH = 320;
+
+    static constexpr int DEFAULT_PROBE_HEIGHT = 180;
+
+private:
+    typedef struct
+    {
+        double secondsPerInputPixel;
+        bool rough; // Measured once on a small probe, only precise enough to dismiss much costlier plans
+    } ModelTiming;
+
+    [[nodiscard]] std::vector<Plan> estimatePlans(double upscaleFactor) const;
+
+    void measureMissingTimings(std::vector<Plan> &plans);
+
+    void measureTimings(const std::vector<Stage> &models, const cv::Size &probeSize, size_t runsNumber, bool rough);
+
+    void measureResizeTiming(const cv::Size &probeSize);
+
+    [[nodiscard]] bool isModelTimingRough(const Stage &stage) const;
+
+    void addPlans(double upscaleFactor, std::vector<Stage> &stages, double networkScale, std::vector<Plan> &plans) const;
+
+    [[nodiscard]] Plan estimatePlan(double upscaleFactor, const std::vector<Stage> &stages) const;
+
+    static double GetStageQualityLoss(const Stage &stage);
+
+    static std::pair<SuperRes::Algo, unsigned short> GetTimingKey(const Stage &stage);
+
+    std::string _modelsPath;
+    std::vector<Stage> _availableModels;
+    std::map<std::pair<SuperRes::Algo, unsigned short>, ModelTiming> _modelsTiming;
+    std::optional<double> _resizeTiming; // Seconds per output pixel
+};
+
+
+#endif //MOVIE_QUALITY_INCREASE_CASCADEPLANNER_H
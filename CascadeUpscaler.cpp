@@ -0,0 +1,143 @@
+#include <stdexcept>
+#include <algorithm>
+#include <future>
+#include <numeric>
+#include <opencv2/imgproc.hpp>
+#include "CascadeUpscaler.h"
+
+CascadeUpscaler::CascadeUpscaler(std::string_view modelsPath, const CascadePlanner::Plan &plan,
+                                 size_t instancesNumber) : _plan(plan)
+{
+    if (instancesNumber == 0)
+    {
+        throw std::invalid_argument("At least one inference instance is needed");
+    }
+    std::vector<size_t> stagesInstancesNumber = ShareInstances(_plan, instancesNumber);
+    for (size_t stage = 0; stage < _plan.stages.size(); ++stage)
+    {
+        std::unique_ptr<StageInstances> stageInstances = std::make_unique<StageInstances>();
+        stageInstances->superResArray = std::vector<SuperRes>(stagesInstancesNumber[stage]);
+        for (size_t i = 0; i < stagesInstancesNumber[stage]; ++i)
+        {
+            stageInstances->superResArray[i].setModelFolderPath(std::string(modelsPath));
+            stageInstances->superResArray[i].setAlgoAndScale(_plan.stages[stage].algo, _plan.stages[stage].scale);
+            stageInstances->vacantSuperresIds.push(i);
+        }
+        _stagesInstances.push_back(std::move(stageInstances));
+    }
+}
+
+void CascadeUpscaler::upRes(const cv::Mat &input, cv::Mat &output)
+{
+    cv::Mat stageInput = input;
+    for (std::unique_ptr<StageInstances> &stageInstances: _stagesInstances)
+    {
+        cv::Mat stageOutput; // New buffer, the previous one may still be read by the caller
+        size_t superresId = AcquireSuperres(*stageInstances);
+        try
+        {
+            stageInstances->superResArray[superresId].upRes(stageInput, stageOutput);
+        } catch (...) // Instance is still usable by other frames
+        {
+            ReleaseSuperres(*stageInstances, superresId);
+            throw;
+        }
+        ReleaseSuperres(*stageInstances, superresId); // Next frame can enter this stage
+        stageInput = std::move(stageOutput);
+    }
+    const cv::Size outputSize = CascadePlanner::GetOutputSize(_plan, input.size());
+    if (stageInput.size() == outputSize)
+    {
+        if (_stagesInstances.empty()) // Output must not share the input buffer
+        {
+            input.copyTo(output);
+        } else
+        {
+            output = std::move(stageInput);
+        }
+        return;
+    }
+    // Vectorized by OpenCV, area interpolation avoids aliasing when the models went too far
+    cv::resize(stageInput, output, outputSize, 0, 0, _plan.remainderFactor > 1.0 ? cv::INTER_CUBIC : cv::INTER_AREA);
+}
+
+void CascadeUpscaler::warmUp(const cv::Size &frameSize, int type)
+{
+    std::vector<std::future<void>> warmUpTasks;
+    cv::Size stageInputSize = frameSize;
+    for (size_t stage = 0; stage < _stagesInstances.size(); ++stage)
+    {
+        // Every instance needs its own setup, so instances are not taken from the vacant queue
+        for (SuperRes &superRes: _stagesInstances[stage]->superResArray)
+        {
+            warmUpTasks.emplace_back(std::async(std::launch::async, [&superRes, stageInputSize, type]() {
+                const cv::Mat dummyFrame(stageInputSize, type, cv::Scalar::all(128));
+                cv::Mat dummyOutput;
+                superRes.upRes(dummyFrame, dummyOutput);
+            }));
+        }
+        stageInputSize = cv::Size(stageInputSize.width * _plan.stages[stage].scale,
+                                  stageInputSize.height * _plan.stages[stage].scale);
+    }
+    for (std::future<void> &warmUpTask: warmUpTasks)
+    {
+        warmUpTask.get(); // Rethrows inference errors
+    }
+}
+
+const CascadePlanner::Plan &CascadeUpscaler::getPlan() const
+{
+    return _plan;
+}
+
+size_t CascadeUpscaler::getStageInstancesNumber(size_t stage) const
+{
+    return _stagesInstances.at(stage)->superResArray.size();
+}
+
+std::vector<size_t> CascadeUpscaler::ShareInstances(const CascadePlanner::Plan &plan, size_t instancesNumber)
+{
+    std::vector<size_t> stagesInstancesNumber(plan.stages.size(), 1);
+    if (plan.stages.empty() || instancesNumber <= plan.stages.size())
+    {
+        return stagesInstancesNumber;
+    }
+    std::vector<double> stagesCost = plan.stagesCost;
+    if (std::accumulate(stagesCost.begin(), stagesCost.end(), 0.0) <= 0.0) // Not timed, share evenly
+    {
+        std::fill(stagesCost.begin(), stagesCost.end(), 1.0);
+    }
+    // Each extra instance goes to the stage that would be the slowest, so that stages throughputs get close
+    for (size_t i = plan.stages.size(); i < instancesNumber; ++i)
+    {
+        size_t slowestStage = 0;
+        for (size_t stage = 1; stage < stagesCost.size(); ++stage)
+        {
+            if (stagesCost[stage] / (double) stagesInstancesNumber[stage] >
+                stagesCost[slowestStage] / (double) stagesInstancesNumber[slowestStage])
+            {
+                slowestStage = stage;
+            }
+        }
+        ++stagesInstancesNumber[slowestStage];
+    }
+    return stagesInstancesNumber;
+}
+
+size_t CascadeUpscaler::AcquireSuperres(StageInstances &stageInstances)
+{
+    std::unique_lock<std::mutex> lckVacantSuperresIds(stageInstances.mtxVacantSuperresIds);
+    stageInstances.conditionVariableNoVacantSuperres.wait(lckVacantSuperresIds, [&]() -> bool {
+        return !stageInstances.vacantSuperresIds.empty();
+    });
+    size_t superresId = stageInstances.vacantSuperresIds.front();
+    stageInstances.vacantSuperresIds.pop();
+    return superresId;
+}
+
+void CascadeUpscaler::ReleaseSuperres(StageInstances &stageInstances, size_t superresId)
+{
+    std::unique_lock<std::mutex> lckVacantSuperresIds(stageInstances.mtxVacantSuperresIds);
+    stageInstances.vacantSuperresIds.push(superresId);
+    stageInstances.conditionVariableNoVacantSuperres.notify_one();
+}
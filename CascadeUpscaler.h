@@ -0,0 +1,86 @@
+#ifndef MOVIE_QUALITY_INCREASE_CASCADEUPSCALER_H
+#define MOVIE_QUALITY_INCREASE_CASCADEUPSCALER_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <queue>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <opencv2/core.hpp>
+#include "SuperRes.h"
+#include "CascadePlanner.h"
+
+class CascadeUpscaler
+{
+public:
+    /**
+     * @brief Construct a new CascadeUpscaler object, loading the models of a plan
+     * @param modelsPath Path to the models folder
+     * @param plan Chain of models to apply, from CascadePlanner
+     * @param instancesNumber Number of inference instances, shared among stages according to their estimated cost
+     * @throw std::invalid_argument If a model of the plan cannot be loaded
+     * @note Each stage gets at least one instance
+     */
+    CascadeUpscaler(std::string_view modelsPath, const CascadePlanner::Plan &plan, size_t instancesNumber);
+
+    CascadeUpscaler(const CascadeUpscaler &other) = delete; // Disallow copy
+
+    CascadeUpscaler &operator=(const CascadeUpscaler &other) = delete; // Disallow copy
+
+    /**
+     * @brief Destroy the CascadeUpscaler object
+     */
+    ~CascadeUpscaler() = default;
+
+    /**
+     * @brief Upscale a frame through every stage of the plan, then resize the remainder
+     * @param input Frame to upscale
+     * @param output Reference to the output frame
+     * @note Thread safe: each stage instance is released as soon as its model is done, so that frames upscaled
+     * from several threads flow through the stages like a pipeline
+     */
+    void upRes(const cv::Mat &input, cv::Mat &output);
+
+    /**
+     * @brief Prime every instance of every stage in parallel, on a dummy frame of its real input size
+     * @param frameSize Size of the frames that will be upscaled
+     * @param type OpenCV pixel type of the frames that will be upscaled
+     */
+    void warmUp(const cv::Size &frameSize, int type);
+
+    /**
+     * @brief Get the plan
+     * @return Plan given at construction
+     */
+    [[nodiscard]] const CascadePlanner::Plan &getPlan() const;
+
+    /**
+     * @brief Get the number of inference instances of a stage
+     * @param stage Stage index in the plan
+     * @return Number of instances
+     */
+    [[nodiscard]] size_t getStageInstancesNumber(size_t stage) const;
+
+private:
+    typedef struct
+    {
+        std::vector<SuperRes> superResArray;
+        std::queue<size_t> vacantSuperresIds;
+        std::mutex mtxVacantSuperresIds;
+        std::condition_variable conditionVariableNoVacantSuperres;
+    } StageInstances;
+
+    static std::vector<size_t> ShareInstances(const CascadePlanner::Plan &plan, size_t instancesNumber);
+
+    static size_t AcquireSuperres(StageInstances &stageInstances);
+
+    static void ReleaseSuperres(StageInstances &stageInstances, size_t superresId);
+
+    CascadePlanner::Plan _plan;
+    std::vector<std::unique_ptr<StageInstances>> _stagesInstances; // Not movable because of the mutex
+};
+
+
+#endif //MOVIE_QUALITY_INCREASE_CASCADEUPSCALER_H
@@ -9,6 +9,20 @@ constexpr std::array<std::string_view, 2> INPUT_FILE_COMMAND = {"--input-file",
 constexpr std::array<std::string_view, 2> OUTPUT_FILE_COMMAND = {"--output-file", "-o"};
 constexpr std::array<std::string_view, 2> MODELS_DIR_COMMAND = {"--models-dir", "-m"};
 constexpr std::array<std::string_view, 2> PARALLEL_INSTANCES = {"--parallel-instances", "-p"};
+constexpr std::array<std::string_view, 2> HYBRID_THRESHOLD_COMMAND = {"--hybrid-threshold", "-t"};
+constexpr std::array<std::string_view, 2> START_FRAME_COMMAND = {"--start", "-s"};
+constexpr std::array<std::string_view, 2> END_FRAME_COMMAND = {"--end", "-e"};
+constexpr std::array<std::string_view, 2> PREVIEW_COMMAND = {"--preview", "-c"};
+constexpr std::array<std::string_view, 2> CODEC_COMMAND = {"--codec", "-k"};
+constexpr std::array<std::string_view, 2> ENCODER_QUALITY_COMMAND = {"--encoder-quality", "-q"};
+constexpr std::array<std::string_view, 2> ENCODER_THREADS_COMMAND = {"--encoder-threads", "-j"};
+constexpr std::array<std::string_view, 2> ENCODER_PRESET_COMMAND = {"--encoder-preset", "-x"};
+constexpr std::array<std::string_view, 2> CONSTANT_RATE_FACTOR_COMMAND = {"--crf", "-r"};
+constexpr std::array<std::string_view, 2> ENCODER_BENCHMARK_COMMAND = {"--benchmark-encoders", "-b"};
+constexpr std::array<std::string_view, 2> WARM_UP_COMMAND = {"--warm-up", "-w"};
+constexpr std::array<std::string_view, 2> KERNEL_CACHE_COMMAND = {"--kernel-cache", "-d"};
+constexpr std::array<std::string_view, 2> KERNEL_TUNING_COMMAND = {"--kernel-tuning", "-u"};
+constexpr std::array<std::string_view, 2> CASCADE_COMMAND = {"--cascade", "-a"};
 
 bool Config::parseCommandLine(int argc, const char *const *argv)
 {
@@ -26,7 +40,7 @@ bool Config::parseCommandLine(int argc, const char *const *argv)
         std::string_view nextArg = argv[i + 1];
         if (currentArg == UPSCALE_FACTOR_COMMAND[0] || currentArg == UPSCALE_FACTOR_COMMAND[1])
         {
-            _upscaleFactor = std::stoi(std::string(nextArg));
+            _upscaleFactor = std::stod(std::string(nextArg));
         } else if (currentArg == INPUT_FILE_COMMAND[0] || currentArg == INPUT_FILE_COMMAND[1])
         {
             _inputFile = std::string(nextArg);
@@ -39,10 +53,64 @@ bool Config::parseCommandLine(int argc, const char *const *argv)
         } else if (currentArg == PARALLEL_INSTANCES[0] || currentArg == PARALLEL_INSTANCES[1])
         {
             _simultaneousInstances = std::stoi(std::string(nextArg));
+        } else if (currentArg == HYBRID_THRESHOLD_COMMAND[0] || currentArg == HYBRID_THRESHOLD_COMMAND[1])
+        {
+            _hybridDetailThreshold = std::stod(std::string(nextArg));
+        } else if (currentArg == START_FRAME_COMMAND[0] || currentArg == START_FRAME_COMMAND[1])
+        {
+            _startFrame = std::stoul(std::string(nextArg));
+        } else if (currentArg == END_FRAME_COMMAND[0] || currentArg == END_FRAME_COMMAND[1])
+        {
+            _endFrame = std::stoul(std::string(nextArg));
+        } else if (currentArg == PREVIEW_COMMAND[0] || currentArg == PREVIEW_COMMAND[1])
+        {
+            _previewClipsNumber = std::stoul(std::string(nextArg));
+        } else if (currentArg == CODEC_COMMAND[0] || currentArg == CODEC_COMMAND[1])
+        {
+            std::optional<VideoEncoder::Codec> codec = VideoEncoder::ParseCodec(nextArg);
+            _codecValid = codec.has_value();
+            _codec = codec.value_or(VideoEncoder::DEFAULT_CODEC);
+        } else if (currentArg == ENCODER_QUALITY_COMMAND[0] || currentArg == ENCODER_QUALITY_COMMAND[1])
+        {
+            _encoderQuality = std::stoi(std::string(nextArg));
+        } else if (currentArg == ENCODER_THREADS_COMMAND[0] || currentArg == ENCODER_THREADS_COMMAND[1])
+        {
+            _encoderThreadsNumber = std::stoi(std::string(nextArg));
+        } else if (currentArg == ENCODER_PRESET_COMMAND[0] || currentArg == ENCODER_PRESET_COMMAND[1])
+        {
+            _encoderPreset = VideoEncoder::ParsePreset(nextArg);
+            _encoderPresetValid = _encoderPreset.has_value();
+        } else if (currentArg == CONSTANT_RATE_FACTOR_COMMAND[0] || currentArg == CONSTANT_RATE_FACTOR_COMMAND[1])
+        {
+            _constantRateFactor = std::stoi(std::string(nextArg));
+        } else if (currentArg == ENCODER_BENCHMARK_COMMAND[0] || currentArg == ENCODER_BENCHMARK_COMMAND[1])
+        {
+            _encoderBenchmarkFramesNumber = std::stoul(std::string(nextArg));
+        } else if (currentArg == WARM_UP_COMMAND[0] || currentArg == WARM_UP_COMMAND[1])
+        {
+            _warmUp = std::stoi(std::string(nextArg)) != 0;
+        } else if (currentArg == KERNEL_CACHE_COMMAND[0] || currentArg == KERNEL_CACHE_COMMAND[1])
+        {
+            _kernelCacheDirectory = std::string(nextArg);
+        } else if (currentArg == KERNEL_TUNING_COMMAND[0] || currentArg == KERNEL_TUNING_COMMAND[1])
+        {
+            _kernelAutoTuning = std::stoi(std::string(nextArg)) != 0;
+        } else if (currentArg == CASCADE_COMMAND[0] || currentArg == CASCADE_COMMAND[1])
+        {
+            _cascadePreference = CascadePlanner::ParsePreference(nextArg);
+            _cascadePreferenceValid = _cascadePreference.has_value();
         }
     }
-    return !_inputFile.empty() && !_outputFile.empty() && !_modelsDirectoryPath.empty() && _upscaleFactor > 0 &&
-           _simultaneousInstances >= 0;
+    return !_inputFile.empty() && !_outputFile.empty() && !_modelsDirectoryPath.empty() && _upscaleFactor >= 1.0 &&
+           _upscaleFactor <= CascadePlanner::MAX_UPSCALE_FACTOR &&
+           _hybridDetailThreshold.value_or(0.0) >= 0.0 &&
+           _endFrame.value_or(_startFrame + 1) > _startFrame && _codecValid && _encoderPresetValid &&
+           (!_encoderQuality.has_value() || VideoEncoder::IsQualitySupported(_codec)) &&
+           ((!_encoderPreset.has_value() && !_constantRateFactor.has_value()) ||
+            VideoEncoder::IsRateControlSupported(_codec)) &&
+           _constantRateFactor.value_or(0) >= 0 &&
+           _constantRateFactor.value_or(0) <= VideoEncoder::MAX_CONSTANT_RATE_FACTOR &&
+           (!_kernelAutoTuning || _kernelCacheDirectory.has_value()) && _cascadePreferenceValid;
 }
 
 void Config::showHelp(std::string_view programPath)
@@ -55,6 +123,20 @@ void Config::showHelp(std::string_view programPath)
     std::cout << " {-o | --output-file} <outputFilePath>";
     std::cout << " {-m | --models-dir} <modelsDirectoryPath>";
     std::cout << " [{-p | --parallel-instances} <simultaneousInstances>]";
+    std::cout << " [{-t | --hybrid-threshold} <detailThreshold>]";
+    std::cout << " [{-s | --start} <startFrame>]";
+    std::cout << " [{-e | --end} <endFrame>]";
+    std::cout << " [{-c | --preview} <previewClipsNumber>]";
+    std::cout << " [{-k | --codec} <avc1 | hevc | mp4v | mjpg | ffv1 | raw>]";
+    std::cout << " [{-q | --encoder-quality} <quality>]";
+    std::cout << " [{-j | --encoder-threads} <encoderThreadsNumber>]";
+    std::cout << " [{-x | --encoder-preset} <ultrafast | ... | medium | ... | veryslow>]";
+    std::cout << " [{-r | --crf} <constantRateFactor>]";
+    std::cout << " [{-b | --benchmark-encoders} <framesNumber>]";
+    std::cout << " [{-w | --warm-up} <0 | 1>]";
+    std::cout << " [{-d | --kernel-cache} <kernelCacheDirectory>]";
+    std::cout << " [{-u | --kernel-tuning} <0 | 1>]";
+    std::cout << " [{-a | --cascade} <speed | balanced | quality>]";
     std::cout << std::endl;
 }
 
@@ -68,7 +150,7 @@ const std::string &Config::getOutputFile() const
     return _outputFile;
 }
 
-unsigned short Config::getUpscaleFactor() const
+double Config::getUpscaleFactor() const
 {
     return _upscaleFactor;
 }
@@ -82,3 +164,73 @@ const std::string &Config::getModelsDirectoryPath() const
 {
     return _modelsDirectoryPath;
 }
+
+std::optional<double> Config::getHybridDetailThreshold() const
+{
+    return _hybridDetailThreshold;
+}
+
+size_t Config::getStartFrame() const
+{
+    return _startFrame;
+}
+
+std::optional<size_t> Config::getEndFrame() const
+{
+    return _endFrame;
+}
+
+size_t Config::getPreviewClipsNumber() const
+{
+    return _previewClipsNumber;
+}
+
+VideoEncoder::Codec Config::getCodec() const
+{
+    return _codec;
+}
+
+std::optional<int> Config::getEncoderQuality() const
+{
+    return _encoderQuality;
+}
+
+std::optional<int> Config::getEncoderThreadsNumber() const
+{
+    return _encoderThreadsNumber;
+}
+
+std::optional<VideoEncoder::Preset> Config::getEncoderPreset() const
+{
+    return _encoderPreset;
+}
+
+std::optional<int> Config::getConstantRateFactor() const
+{
+    return _constantRateFactor;
+}
+
+size_t Config::getEncoderBenchmarkFramesNumber() const
+{
+    return _encoderBenchmarkFramesNumber;
+}
+
+bool Config::getWarmUp() const
+{
+    return _warmUp;
+}
+
+const std::optional<std::string> &Config::getKernelCacheDirectory() const
+{
+    return _kernelCacheDirectory;
+}
+
+bool Config::getKernelAutoTuning() const
+{
+    return _kernelAutoTuning;
+}
+
+std::optional<CascadePlanner::Preference> Config::getCascadePreference() const
+{
+    return _cascadePreference;
+}
\ No newline at end of file
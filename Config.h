@@ -2,6 +2,9 @@
 #define MOVIE_QUALITY_INCREASE_CONFIG_H
 
 #include <string>
+#include <optional>
+#include "VideoEncoder.h"
+#include "CascadePlanner.h"
 
 class Config
 {
@@ -49,9 +52,9 @@ public:
      * @brief Get quality increase value
      * @return Quality increase value
      * @note parseCommandLine() must be called before
-     * @note Quality increase value coould be 2, 3, 4 or 8
+     * @note Quality increase value may be any factor from 1, factors other than 2, 3 or 4 use a chain of models
      */
-    [[nodiscard]] unsigned short getUpscaleFactor() const;
+    [[nodiscard]] double getUpscaleFactor() const;
 
     /**
      * @brief Get number of simultaneous inference instances
@@ -71,12 +74,131 @@ public:
      */
     [[nodiscard]] const std::string &getModelsDirectoryPath() const;
 
+    /**
+     * @brief Get hybrid upscaling detail threshold
+     * @return Detail threshold, std::nullopt if hybrid upscaling wasn't requested
+     * @note parseCommandLine() must be called before
+     * @note Only tiles whose mean gradient is above this threshold go through the neural network
+     */
+    [[nodiscard]] std::optional<double> getHybridDetailThreshold() const;
+
+    /**
+     * @brief Get the first frame to upscale
+     * @return First frame number, 0 by default
+     * @note parseCommandLine() must be called before
+     */
+    [[nodiscard]] size_t getStartFrame() const;
+
+    /**
+     * @brief Get the frame after the last frame to upscale
+     * @return End frame number, std::nullopt to upscale until the end of the video
+     * @note parseCommandLine() must be called before
+     */
+    [[nodiscard]] std::optional<size_t> getEndFrame() const;
+
+    /**
+     * @brief Get the number of preview clips
+     * @return Number of preview clips, 0 if a full run was requested
+     * @note parseCommandLine() must be called before
+     */
+    [[nodiscard]] size_t getPreviewClipsNumber() const;
+
+    /**
+     * @brief Get the output video codec
+     * @return Codec, AVC1 by default
+     * @note parseCommandLine() must be called before
+     */
+    [[nodiscard]] VideoEncoder::Codec getCodec() const;
+
+    /**
+     * @brief Get the encoder quality
+     * @return Quality (0 - 100), std::nullopt for the backend default
+     * @note parseCommandLine() must be called before
+     * @note Only valid with the mjpg codec
+     */
+    [[nodiscard]] std::optional<int> getEncoderQuality() const;
+
+    /**
+     * @brief Get the number of encoder threads
+     * @return Number of threads, std::nullopt for the backend default
+     * @note parseCommandLine() must be called before
+     */
+    [[nodiscard]] std::optional<int> getEncoderThreadsNumber() const;
+
+    /**
+     * @brief Get the encoder speed preset
+     * @return Preset, std::nullopt for the encoder default
+     * @note parseCommandLine() must be called before
+     * @note Only valid with the avc1 and hevc codecs
+     */
+    [[nodiscard]] std::optional<VideoEncoder::Preset> getEncoderPreset() const;
+
+    /**
+     * @brief Get the encoder constant rate factor
+     * @return Constant rate factor (0 - 51), std::nullopt for the encoder default
+     * @note parseCommandLine() must be called before
+     * @note Only valid with the avc1 and hevc codecs
+     */
+    [[nodiscard]] std::optional<int> getConstantRateFactor() const;
+
+    /**
+     * @brief Get the number of frames used to benchmark encoders
+     * @return Number of frames, 0 if no benchmark was requested
+     * @note parseCommandLine() must be called before
+     */
+    [[nodiscard]] size_t getEncoderBenchmarkFramesNumber() const;
+
+    /**
+     * @brief Tell whether inference instances must be warmed up before upscaling
+     * @return True by default
+     * @note parseCommandLine() must be called before
+     */
+    [[nodiscard]] bool getWarmUp() const;
+
+    /**
+     * @brief Get the compiled kernels cache directory
+     * @return Cache directory, std::nullopt if kernels are not persisted
+     * @note parseCommandLine() must be called before
+     */
+    [[nodiscard]] const std::optional<std::string> &getKernelCacheDirectory() const;
+
+    /**
+     * @brief Tell whether DNN kernels must be tuned for the network input shape
+     * @return False by default, only accepted with a kernel cache directory
+     * @note parseCommandLine() must be called before
+     */
+    [[nodiscard]] bool getKernelAutoTuning() const;
+
+    /**
+     * @brief Get the chain of models preference
+     * @return Preference, std::nullopt to use a single model when it supports the upscale factor
+     * @note parseCommandLine() must be called before
+     */
+    [[nodiscard]] std::optional<CascadePlanner::Preference> getCascadePreference() const;
+
 private:
     std::string _inputFile;
     std::string _outputFile;
-    unsigned short _upscaleFactor = 0;
+    double _upscaleFactor = 0.0;
     unsigned short _simultaneousInstances = 0; // Number of simultaneous instances of inference
     std::string _modelsDirectoryPath;
+    std::optional<double> _hybridDetailThreshold;
+    size_t _startFrame = 0;
+    std::optional<size_t> _endFrame;
+    size_t _previewClipsNumber = 0; // Full run if 0
+    VideoEncoder::Codec _codec = VideoEncoder::DEFAULT_CODEC;
+    bool _codecValid = true; // False if an unknown codec name was given
+    std::optional<int> _encoderQuality;
+    std::optional<int> _encoderThreadsNumber;
+    std::optional<VideoEncoder::Preset> _encoderPreset;
+    bool _encoderPresetValid = true; // False if an unknown preset name was given
+    std::optional<int> _constantRateFactor;
+    size_t _encoderBenchmarkFramesNumber = 0; // No benchmark if 0
+    bool _warmUp = true;
+    std::optional<CascadePlanner::Preference> _cascadePreference;
+    bool _cascadePreferenceValid = true; // False if an unknown preference name was given
+    std::optional<std::string> _kernelCacheDirectory;
+    bool _kernelAutoTuning = false;
 };
 
 
@@ -0,0 +1,469 @@
+#include <stdexcept>
+#include <opencv2/imgproc.hpp>
+#include "FrameUpscaler.h"
+
+FrameUpscaler::FrameUpscaler(std::string_view modelsPath, unsigned short upscaleFactor,
+                             size_t superresInstancesNumber) : _upscaleFactor(upscaleFactor),
+                                                               _superresInstancesNumber(superresInstancesNumber),
+                                                               _superResArray(superresInstancesNumber),
+                                                               _outputMats(superresInstancesNumber),
+                                                               _outputTimestamps(superresInstancesNumber, 0)
+{
+    if (superresInstancesNumber == 0)
+    {
+        throw std::invalid_argument("At least one inference instance is needed");
+    }
+    for (size_t i = 0; i < _superresInstancesNumber; i++)
+    {
+        _superResArray[i].setModelFolderPath(std::string(modelsPath));
+        _superResArray[i].setAlgoAndScale(DEFAULT_SUPERRES_ALGO, upscaleFactor);
+    }
+}
+
+FrameUpscaler::FrameUpscaler(std::string_view modelsPath, const CascadePlanner::Plan &cascadePlan,
+                             size_t superresInstancesNumber) : _upscaleFactor(cascadePlan.upscaleFactor),
+                                                               _superresInstancesNumber(superresInstancesNumber),
+                                                               _outputMats(superresInstancesNumber),
+                                                               _outputTimestamps(superresInstancesNumber, 0)
+{
+    if (superresInstancesNumber == 0)
+    {
+        throw std::invalid_argument("At least one inference instance is needed");
+    }
+    _cascadeUpscaler = std::make_unique<CascadeUpscaler>(modelsPath, cascadePlan, superresInstancesNumber);
+}
+
+FrameUpscaler::~FrameUpscaler()
+{
+    {
+        std::unique_lock<std::mutex> lckUpscaledFrames(_mtxUpscaledFrames);
+        _discardOutput = true; // Don't let the consumer thread wait for a pull that will never happen
+        _conditionVariableOutputOverflow.notify_one();
+    }
+    try
+    {
+        finish();
+    } catch (...) // Nobody can handle an inference error anymore
+    {
+    }
+    if (_consumerSuperresFuturesThread.joinable())
+    {
+        {
+            std::unique_lock<std::mutex> lckSuperresTasks(_mtxSuperresTasks);
+            _stopConsumer = true; // Once every queued task is consumed
+            _conditionVariableQueueEmpty.notify_one();
+        }
+        _consumerSuperresFuturesThread.join();
+    }
+}
+
+void FrameUpscaler::warmUp(const cv::Size &frameSize, int type)
+{
+    if (_streamStarted || !isIdle())
+    {
+        throw std::logic_error("Warm up must be done between streams, once every frame is upscaled");
+    }
+    if (_cascadeUpscaler)
+    {
+        _cascadeUpscaler->warmUp(frameSize, type);
+        return;
+    }
+    // Same input shape as real inferences, so that shape dependent setup is done too
+    const cv::Mat dummyFrame(GetNetworkInputSize(frameSize, getHybridDetailThreshold()), type, cv::Scalar::all(128));
+    std::vector<std::future<void>> warmUpTasks;
+    for (size_t i = 0; i < _superresInstancesNumber; ++i)
+    {
+        warmUpTasks.emplace_back(std::async(std::launch::async, [this, i, &dummyFrame]() {
+            cv::Mat dummyOutput;
+            _superResArray[i].upRes(dummyFrame, dummyOutput);
+        }));
+    }
+    for (std::future<void> &warmUpTask: warmUpTasks)
+    {
+        warmUpTask.get(); // Rethrows inference errors
+    }
+}
+
+void FrameUpscaler::push(cv::Mat &&frame, int64_t timestamp)
+{
+    pushFrame(std::make_shared<cv::Mat>(std::move(frame)), timestamp);
+}
+
+void FrameUpscaler::push(void *data, int width, int height, int type, size_t step, int64_t timestamp,
+                         const std::function<void()> &releaseCallback)
+{
+    // The frame only wraps the buffer, which is given back once the last task using it is done
+    auto releaseFrame = [releaseCallback](cv::Mat *frame) {
+        delete frame;
+        if (releaseCallback)
+        {
+            releaseCallback();
+        }
+    };
+    std::shared_ptr<cv::Mat> framePtr(new cv::Mat(height, width, type, data, step), releaseFrame);
+    pushFrame(framePtr, timestamp);
+}
+
+void FrameUpscaler::push(YuvFormat yuvFormat, const std::vector<const void *> &planes, const std::vector<size_t> &steps,
+                         int width, int height, int64_t timestamp)
+{
+    const size_t planesNumber = yuvFormat == YuvFormat::NV12 ? 2 : 3;
+    if (planes.size() != planesNumber || steps.size() != planesNumber)
+    {
+        throw std::invalid_argument("Wrong number of planes for the YUV format");
+    }
+    if (width <= 0 || height <= 0 || width % 2 != 0 || height % 2 != 0) // Chroma is subsampled by 2
+    {
+        throw std::invalid_argument("YUV 4:2:0 frame size must be even");
+    }
+    // Wrapped without copy, the planes are only read by the conversion
+    const cv::Mat yPlane(height, width, CV_8UC1, const_cast<void *>(planes[0]), steps[0]);
+    cv::Mat frame;
+    if (yuvFormat == YuvFormat::NV12)
+    {
+        const cv::Mat uvPlane(height / 2, width / 2, CV_8UC2, const_cast<void *>(planes[1]), steps[1]);
+        cv::cvtColorTwoPlane(yPlane, uvPlane, frame, cv::COLOR_YUV2BGR_NV12);
+    } else
+    {
+        // OpenCV only converts contiguous I420, so the planes are gathered first
+        cv::Mat contiguousFrame(height * 3 / 2, width, CV_8UC1);
+        yPlane.copyTo(contiguousFrame.rowRange(0, height));
+        uchar *chromaDestination = contiguousFrame.ptr(height);
+        for (size_t plane = 1; plane < planesNumber; ++plane)
+        {
+            const cv::Mat chromaPlane(height / 2, width / 2, CV_8UC1, const_cast<void *>(planes[plane]), steps[plane]);
+            cv::Mat chromaDestinationPlane(height / 2, width / 2, CV_8UC1, chromaDestination); // Packed rows
+            chromaPlane.copyTo(chromaDestinationPlane);
+            chromaDestination += chromaPlane.total();
+        }
+        cv::cvtColor(contiguousFrame, frame, cv::COLOR_YUV2BGR_I420);
+    }
+    push(std::move(frame), timestamp);
+}
+
+void FrameUpscaler::finish()
+{
+    if (_streamStarted)
+    {
+        std::unique_lock<std::mutex> lckSuperresTasks(_mtxSuperresTasks);
+        _waitingSuperresTasks.push(std::nullopt); // Tell consumer thread the stream is over
+        _streamStarted = false;
+        _conditionVariableQueueEmpty.notify_one();
+    }
+    if (_outputCallback.has_value())
+    {
+        std::unique_lock<std::mutex> lckUpscaledFrames(_mtxUpscaledFrames);
+        _conditionVariableStreamDelivered.wait(lckUpscaledFrames, [&]() -> bool {
+            return _deliveredStreamsNumber == _startedStreamsNumber; // Every frame has been given to the callback
+        });
+    }
+    rethrowTaskException();
+}
+
+std::optional<FrameUpscaler::UpscaledFrame> FrameUpscaler::poll()
+{
+    std::unique_lock<std::mutex> lckUpscaledFrames(_mtxUpscaledFrames);
+    while (!_upscaledFrames.empty() && !_upscaledFrames.front().has_value()) // End of a stream, nothing to return
+    {
+        _upscaledFrames.pop();
+        ++_pulledStreamsNumber;
+        _conditionVariableOutputOverflow.notify_one();
+    }
+    if (_upscaledFrames.empty())
+    {
+        return std::nullopt;
+    }
+    std::optional<UpscaledFrame> upscaledFrame = std::move(_upscaledFrames.front());
+    _upscaledFrames.pop();
+    _conditionVariableOutputOverflow.notify_one();
+    return upscaledFrame;
+}
+
+std::optional<FrameUpscaler::UpscaledFrame> FrameUpscaler::pull()
+{
+    std::unique_lock<std::mutex> lckUpscaledFrames(_mtxUpscaledFrames);
+    _conditionVariableOutputEmpty.wait(lckUpscaledFrames, [&]() -> bool {
+        return !_upscaledFrames.empty() || (_startedStreamsNumber > 0 && _pulledStreamsNumber == _startedStreamsNumber);
+    });
+    if (_upscaledFrames.empty()) // Last stream finished and already pulled
+    {
+        return std::nullopt;
+    }
+    std::optional<UpscaledFrame> upscaledFrame = std::move(_upscaledFrames.front());
+    _upscaledFrames.pop();
+    if (!upscaledFrame.has_value()) // End of a stream
+    {
+        ++_pulledStreamsNumber;
+    }
+    _conditionVariableOutputOverflow.notify_one();
+    return upscaledFrame;
+}
+
+void FrameUpscaler::setOutputCallback(std::optional<OutputCallback> outputCallback)
+{
+    _outputCallback = std::move(outputCallback);
+}
+
+size_t FrameUpscaler::getOutputQueueCapacity() const
+{
+    return _outputQueueCapacity;
+}
+
+void FrameUpscaler::setOutputQueueCapacity(size_t outputQueueCapacity)
+{
+    if (outputQueueCapacity == 0)
+    {
+        throw std::invalid_argument("Output queue capacity must be at least 1");
+    }
+    _outputQueueCapacity = outputQueueCapacity;
+}
+
+std::optional<double> FrameUpscaler::getHybridDetailThreshold() const
+{
+    if (!_hybridUpscaler.has_value())
+    {
+        return std::nullopt;
+    }
+    return _hybridUpscaler->getDetailThreshold();
+}
+
+void FrameUpscaler::setHybridDetailThreshold(std::optional<double> hybridDetailThreshold)
+{
+    if (hybridDetailThreshold.has_value() && _cascadeUpscaler)
+    {
+        throw std::logic_error("Hybrid upscaling is not available with a chain of models");
+    }
+    if (hybridDetailThreshold.has_value())
+    {
+        _hybridUpscaler.emplace(hybridDetailThreshold.value());
+    } else
+    {
+        _hybridUpscaler.reset();
+    }
+}
+
+double FrameUpscaler::getUpscaleFactor() const
+{
+    return _upscaleFactor;
+}
+
+cv::Size FrameUpscaler::getOutputSize(const cv::Size &frameSize) const
+{
+    if (_cascadeUpscaler)
+    {
+        return CascadePlanner::GetOutputSize(_cascadeUpscaler->getPlan(), frameSize);
+    }
+    return {frameSize.width * (int) _upscaleFactor, frameSize.height * (int) _upscaleFactor};
+}
+
+cv::Size FrameUpscaler::GetNetworkInputSize(const cv::Size &frameSize, std::optional<double> hybridDetailThreshold)
+{
+    if (hybridDetailThreshold.has_value()) // Same tiling as setHybridDetailThreshold()
+    {
+        const int tileInputSize = HybridUpscaler(hybridDetailThreshold.value()).getTileInputSize();
+        return {tileInputSize, tileInputSize};
+    }
+    return frameSize;
+}
+
+std::optional<CascadePlanner::Plan> FrameUpscaler::getCascadePlan() const
+{
+    if (!_cascadeUpscaler)
+    {
+        return std::nullopt;
+    }
+    return _cascadeUpscaler->getPlan();
+}
+
+size_t FrameUpscaler::getSuperresInstancesNumber() const
+{
+    return _superresInstancesNumber;
+}
+
+double FrameUpscaler::getDnnPixelsFraction() const
+{
+    if (_activePixelsNumber == 0)
+    {
+        return 0.0;
+    }
+    return (double) _dnnCoveredPixelsNumber / (double) _activePixelsNumber;
+}
+
+double FrameUpscaler::getDnnMarginsOverhead() const
+{
+    if (_dnnCoveredPixelsNumber == 0)
+    {
+        return 0.0;
+    }
+    return (double) _dnnInputPixelsNumber / (double) _dnnCoveredPixelsNumber - 1.0;
+}
+
+void FrameUpscaler::pushFrame(const std::shared_ptr<cv::Mat> &framePtr, int64_t timestamp)
+{
+    rethrowTaskException();
+    if (!_streamStarted)
+    {
+        startStream();
+    }
+
+    cv::Rect activeArea; // Letterbox bars are detected here, because frames must be analyzed in order
+    if (_hybridUpscaler.has_value())
+    {
+        activeArea = _sceneAnalyzer.getActiveArea(*framePtr);
+    }
+
+    size_t superresId;
+    {
+        std::unique_lock<std::mutex> lckSuperresTasks(_mtxSuperresTasks);
+        _conditionVariableQueueOverflow.wait(lckSuperresTasks, [&]() -> bool {
+            return !_vacantSuperresAndOutputIds.empty(); // Wait until there is an available superres and output
+        });
+        superresId = _vacantSuperresAndOutputIds.front(); // First available superres and output frame
+        _vacantSuperresAndOutputIds.pop();
+    }
+    _outputTimestamps[superresId] = timestamp;
+    auto superresFrame = [this, superresId, framePtr, activeArea]() -> size_t {
+        try
+        {
+            if (_cascadeUpscaler) // Several frames may be in different stages at the same time
+            {
+                _cascadeUpscaler->upRes(*framePtr, _outputMats[superresId]);
+                if (!_cascadeUpscaler->getPlan().stages.empty()) // Else resize only
+                {
+                    _dnnCoveredPixelsNumber += framePtr->total();
+                    _dnnInputPixelsNumber += framePtr->total();
+                }
+                _activePixelsNumber += framePtr->total();
+            } else if (_hybridUpscaler.has_value())
+            {
+                const HybridUpscaler::DnnWorkload dnnWorkload =
+                        _hybridUpscaler->upRes(_superResArray[superresId], *framePtr, activeArea,
+                                               _outputMats[superresId]);
+                _dnnCoveredPixelsNumber += dnnWorkload.coveredPixelsNumber;
+                _dnnInputPixelsNumber += dnnWorkload.inputPixelsNumber;
+                _activePixelsNumber += (unsigned long long) activeArea.area();
+            } else
+            {
+                _superResArray[superresId].upRes(*framePtr, _outputMats[superresId]);
+                _dnnCoveredPixelsNumber += framePtr->total();
+                _dnnInputPixelsNumber += framePtr->total();
+                _activePixelsNumber += framePtr->total();
+            }
+        } catch (...) // Reported to the producer, the frame is dropped
+        {
+            std::unique_lock<std::mutex> lckTaskException(_mtxTaskException);
+            if (!_taskException)
+            {
+                _taskException = std::current_exception();
+            }
+            _outputMats[superresId].release();
+        }
+        return superresId;
+    };
+    std::future<size_t> superresTask = std::async(std::launch::async, superresFrame); // New task to superres a frame
+
+    std::unique_lock<std::mutex> lckSuperresTasks(_mtxSuperresTasks);
+    _waitingSuperresTasks.emplace(std::move(superresTask));
+    _conditionVariableQueueEmpty.notify_one(); // If queue was empty, no longer empty
+}
+
+void FrameUpscaler::startStream()
+{
+    if (!_consumerSuperresFuturesThread.joinable()) // First stream, consumer thread then serves every stream
+    {
+        for (size_t i = 0; i < _superresInstancesNumber; ++i)
+        {
+            _vacantSuperresAndOutputIds.push(i);
+        }
+        _consumerSuperresFuturesThread = std::thread(&FrameUpscaler::consumeSuperresFuturesTask, this);
+    }
+    _streamStarted = true;
+    _sceneAnalyzer.reset();
+    std::unique_lock<std::mutex> lckUpscaledFrames(_mtxUpscaledFrames);
+    ++_startedStreamsNumber;
+}
+
+bool FrameUpscaler::isIdle()
+{
+    std::unique_lock<std::mutex> lckSuperresTasks(_mtxSuperresTasks);
+    return !_consumerSuperresFuturesThread.joinable() ||
+           _vacantSuperresAndOutputIds.size() == _superresInstancesNumber;
+}
+
+void FrameUpscaler::consumeSuperresFuturesTask()
+{
+    while (true)
+    {
+        std::optional<std::future<size_t>> taskOutputFrameId; // Task will return output frame id
+        {
+            std::unique_lock<std::mutex> lckSuperresTasks(_mtxSuperresTasks);
+            _conditionVariableQueueEmpty.wait(lckSuperresTasks, [&]() -> bool {
+                return !_waitingSuperresTasks.empty() || _stopConsumer;
+            });
+            if (_waitingSuperresTasks.empty()) // Destruction, every stream is over
+            {
+                return;
+            }
+            taskOutputFrameId = std::move(_waitingSuperresTasks.front());
+            _waitingSuperresTasks.pop();
+        }
+        if (!taskOutputFrameId.has_value()) // End of stream, next tasks belong to the next stream
+        {
+            deliverFrame(std::nullopt);
+            continue;
+        }
+        size_t superresAndOutputId = taskOutputFrameId.value().get(); // Wait until task is finished
+        UpscaledFrame upscaledFrame{std::move(_outputMats[superresAndOutputId]),
+                                    _outputTimestamps[superresAndOutputId]}; // Next inference allocates a new frame
+        {
+            std::unique_lock<std::mutex> lckSuperresTasks(_mtxSuperresTasks);
+            _vacantSuperresAndOutputIds.push(superresAndOutputId); // Can reuse superres instance and output frame
+            _conditionVariableQueueOverflow.notify_one();
+        }
+        if (!upscaledFrame.frame.empty()) // Failed frames are dropped
+        {
+            deliverFrame(std::move(upscaledFrame));
+        }
+    }
+}
+
+void FrameUpscaler::deliverFrame(std::optional<UpscaledFrame> &&upscaledFrame)
+{
+    if (_outputCallback.has_value())
+    {
+        if (upscaledFrame.has_value())
+        {
+            _outputCallback.value()(std::move(upscaledFrame.value()));
+            return;
+        }
+        std::unique_lock<std::mutex> lckUpscaledFrames(_mtxUpscaledFrames);
+        ++_deliveredStreamsNumber;
+        _conditionVariableStreamDelivered.notify_all();
+        return;
+    }
+    std::unique_lock<std::mutex> lckUpscaledFrames(_mtxUpscaledFrames);
+    _conditionVariableOutputOverflow.wait(lckUpscaledFrames, [&]() -> bool {
+        return _upscaledFrames.size() < _outputQueueCapacity || _discardOutput;
+    });
+    if (!upscaledFrame.has_value())
+    {
+        ++_deliveredStreamsNumber;
+        _conditionVariableStreamDelivered.notify_all();
+    }
+    if (!_discardOutput)
+    {
+        _upscaledFrames.push(std::move(upscaledFrame));
+        _conditionVariableOutputEmpty.notify_all(); // End of stream may wake several pullers
+    }
+}
+
+void FrameUpscaler::rethrowTaskException()
+{
+    std::unique_lock<std::mutex> lckTaskException(_mtxTaskException);
+    if (_taskException)
+    {
+        std::exception_ptr taskException = _taskException;
+        _taskException = nullptr;
+        std::rethrow_exception(taskException);
+    }
+}
@@ -0,0 +1,302 @@
+#ifndef MOVIE_QUALITY_INCREASE_FRAMEUPSCALER_H
+#define MOVIE_QUALITY_INCREASE_FRAMEUPSCALER_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <queue>
+#include <future>
+#include <optional>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <exception>
+#include <cstdint>
+#include <opencv2/core.hpp>
+#include "SuperRes.h"
+#include "HybridUpscaler.h"
+#include "SceneAnalyzer.h"
+#include "CascadePlanner.h"
+#include "CascadeUpscaler.h"
+
+class FrameUpscaler
+{
+public:
+    typedef struct
+    {
+        cv::Mat frame; // Upscaled frame, owned by the receiver
+        int64_t timestamp; // Timestamp given when the input frame was pushed
+    } UpscaledFrame;
+
+    typedef std::function<void(UpscaledFrame &&upscaledFrame)> OutputCallback;
+
+    enum class YuvFormat
+    {
+        /**
+         * @brief Y plane followed by an interleaved UV plane, as given by most hardware decoders
+         */
+        NV12,
+
+        /**
+         * @brief Y, U and V planes, as given by most software decoders
+         */
+        I420
+    };
+
+    /**
+     * @brief Construct a new FrameUpscaler object, loading the inference models
+     * @param modelsPath Path to the models folder
+     * @param upscaleFactor Frames upscale factor (2, 3, 4, depending on the model)
+     * @param superresInstancesNumber Number of concurrent inference instances
+     * @throw std::invalid_argument If the models folder doesn't exist or if the upscale factor is not supported
+     * @note Models folder must contain the following subfolders:
+     * EDSR, ESPCN, FSRCNN, LapSRN.
+     */
+    FrameUpscaler(std::string_view modelsPath, unsigned short upscaleFactor,
+                  size_t superresInstancesNumber = DEFAULT_SUPERRES_INSTANCES_NUMBER);
+
+    /**
+     * @brief Construct a new FrameUpscaler object running a chain of models, for any upscale factor
+     * @param modelsPath Path to the models folder
+     * @param cascadePlan Chain of models to apply, from CascadePlanner
+     * @param superresInstancesNumber Number of concurrent inference instances, shared among the chain stages
+     * @throw std::invalid_argument If the models folder doesn't exist or if a model of the plan cannot be loaded
+     * @note Hybrid upscaling is not available with a chain of models
+     */
+    FrameUpscaler(std::string_view modelsPath, const CascadePlanner::Plan &cascadePlan,
+                  size_t superresInstancesNumber = DEFAULT_SUPERRES_INSTANCES_NUMBER);
+
+    FrameUpscaler(const FrameUpscaler &other) = delete; // Disallow copy
+
+    FrameUpscaler &operator=(const FrameUpscaler &other) = delete; // Disallow copy
+
+    /**
+     * @brief Destroy the FrameUpscaler object
+     * @note Waits for frames being upscaled, frames that were not pulled yet are discarded
+     */
+    ~FrameUpscaler();
+
+    /**
+     * @brief Prime every inference instance in parallel on a dummy frame
+     * @param frameSize Size of the frames that will be pushed
+     * @param type OpenCV pixel type of the frames that will be pushed
+     * @throw std::logic_error If a stream is in progress or frames are still being upscaled
+     * @note Network setup and kernel compilation otherwise happen on the first frame of each instance
+     */
+    void warmUp(const cv::Size &frameSize, int type = CV_8UC3);
+
+    /**
+     * @brief Push a frame to upscale
+     * @param frame Frame to upscale, ownership is transferred without copy
+     * @param timestamp Timestamp given back with the upscaled frame
+     * @throw Any exception thrown while upscaling a previous frame
+     * @note Blocks while every inference instance is busy
+     * @note Frames are given back in push order
+     * @note Without output callback, instances are only freed when the output queue has room, so a caller pushing and
+     * pulling from a single thread must poll() between pushes
+     */
+    void push(cv::Mat &&frame, int64_t timestamp);
+
+    /**
+     * @brief Push a frame to upscale from a raw buffer, without copy
+     * @param data Pointer to the first pixel, must stay valid until releaseCallback is called
+     * @param width Frame width, in pixels
+     * @param height Frame height, in pixels
+     * @param type OpenCV pixel type, usually CV_8UC3 (BGR)
+     * @param step Number of bytes between two rows
+     * @param timestamp Timestamp given back with the upscaled frame
+     * @param releaseCallback Called once the buffer is no longer used, may be nullptr
+     * @throw Any exception thrown while upscaling a previous frame
+     * @note Blocks while every inference instance is busy
+     * @note Only packed single plane buffers, see the YUV overload for planar frames
+     */
+    void push(void *data, int width, int height, int type, size_t step, int64_t timestamp,
+              const std::function<void()> &releaseCallback);
+
+    /**
+     * @brief Push a planar YUV 4:2:0 frame to upscale, converted to BGR before inference
+     * @param yuvFormat Layout of the planes
+     * @param planes Pointer to the first byte of each plane: Y then UV for NV12, Y, U then V for I420
+     * @param steps Number of bytes between two rows of each plane
+     * @param width Frame width, in pixels, must be even
+     * @param height Frame height, in pixels, must be even
+     * @param timestamp Timestamp given back with the upscaled frame
+     * @throw std::invalid_argument If the number of planes doesn't match the format, or if the size is odd
+     * @throw Any exception thrown while upscaling a previous frame
+     * @note Planes are only read during the call, they may be reused as soon as it returns
+     * @note Blocks while every inference instance is busy
+     */
+    void push(YuvFormat yuvFormat, const std::vector<const void *> &planes, const std::vector<size_t> &steps,
+              int width, int height, int64_t timestamp);
+
+    /**
+     * @brief Signal the end of the stream
+     * @throw Any exception thrown while upscaling a frame
+     * @note With an output callback, returns once every frame has been given to the callback
+     * @note Without output callback, returns immediately, pull() returns std::nullopt once every frame was pulled
+     * @note Pushing a frame after finish() starts a new stream, frames of the previous one don't need to be pulled
+     * first
+     */
+    void finish();
+
+    /**
+     * @brief Get the next upscaled frame if available
+     * @return Next upscaled frame, std::nullopt if none is ready
+     * @note Only used without output callback
+     * @note Skips the ends of streams, use pull() to detect them
+     */
+    std::optional<UpscaledFrame> poll();
+
+    /**
+     * @brief Wait for the next upscaled frame
+     * @return Next upscaled frame, std::nullopt once at the end of each stream, then again until a new stream starts
+     * @note Only used without output callback
+     */
+    std::optional<UpscaledFrame> pull();
+
+    /**
+     * @brief Set the callback receiving upscaled frames
+     * @param outputCallback Callback called from an internal thread, in push order,
+     * std::nullopt to pull frames with poll() or pull()
+     * @note Must be set before the first push of a stream
+     */
+    void setOutputCallback(std::optional<OutputCallback> outputCallback);
+
+    /**
+     * @brief Get the maximum number of upscaled frames waiting to be pulled
+     * @return Output queue capacity
+     */
+    [[nodiscard]] size_t getOutputQueueCapacity() const;
+
+    /**
+     * @brief Set the maximum number of upscaled frames waiting to be pulled
+     * @param outputQueueCapacity Output queue capacity, at least 1
+     * @throw std::invalid_argument If output queue capacity is 0
+     * @note Inference instances stop when the queue is full
+     */
+    void setOutputQueueCapacity(size_t outputQueueCapacity);
+
+    /**
+     * @brief Get the hybrid upscaling detail threshold
+     * @return Detail threshold, std::nullopt if every pixel goes through the neural network
+     */
+    [[nodiscard]] std::optional<double> getHybridDetailThreshold() const;
+
+    /**
+     * @brief Enable or disable hybrid upscaling
+     * @param hybridDetailThreshold Mean gradient magnitude (0 - 255) above which a tile goes through the neural network,
+     * std::nullopt to send every pixel to the neural network
+     * @throw std::logic_error If frames are upscaled by a chain of models
+     * @note Must be set before the first push of a stream
+     */
+    void setHybridDetailThreshold(std::optional<double> hybridDetailThreshold);
+
+    /**
+     * @brief Get the upscale factor
+     * @return Upscale factor, may be non-integer with a chain of models
+     */
+    [[nodiscard]] double getUpscaleFactor() const;
+
+    /**
+     * @brief Get the size of upscaled frames
+     * @param frameSize Size of pushed frames
+     * @return Size of upscaled frames
+     */
+    [[nodiscard]] cv::Size getOutputSize(const cv::Size &frameSize) const;
+
+    /**
+     * @brief Get the input size of each inference of the first model
+     * @param frameSize Size of pushed frames
+     * @param hybridDetailThreshold Hybrid detail threshold that will be set, see setHybridDetailThreshold()
+     * @return Frame size, or tile size with its margins in hybrid mode
+     * @note Static, so that shape dependent caches can be set up before the models are loaded
+     */
+    static cv::Size GetNetworkInputSize(const cv::Size &frameSize, std::optional<double> hybridDetailThreshold);
+
+    /**
+     * @brief Get the chain of models
+     * @return Plan, std::nullopt if a single model is used
+     */
+    [[nodiscard]] std::optional<CascadePlanner::Plan> getCascadePlan() const;
+
+    /**
+     * @brief Get the number of concurrent inference instances
+     * @return Simultaneous inference instances
+     */
+    [[nodiscard]] size_t getSuperresInstancesNumber() const;
+
+    /**
+     * @brief Get the share of the frames upscaled by the neural network so far
+     * @return Active area pixels covered by the neural network divided by the active area pixels, 0 if no frame has
+     * been processed
+     * @note The active area is the whole frame outside hybrid mode
+     */
+    [[nodiscard]] double getDnnPixelsFraction() const;
+
+    /**
+     * @brief Get the neural network work spent on tiles margins so far
+     * @return Pixels given to the neural network divided by the pixels it covered, minus 1, 0 if nothing went
+     * through the neural network
+     * @note Only hybrid mode has margins
+     */
+    [[nodiscard]] double getDnnMarginsOverhead() const;
+
+    static constexpr size_t DEFAULT_SUPERRES_INSTANCES_NUMBER = 8; // 8 simultaneous inference instances by default, reduce if you run out of memory
+
+    static constexpr SuperRes::Algo DEFAULT_SUPERRES_ALGO = SuperRes::Algo::ESPCN; // Should not be changed, because it's the best for movies
+
+    static constexpr size_t DEFAULT_OUTPUT_QUEUE_CAPACITY = 8;
+
+private:
+    void pushFrame(const std::shared_ptr<cv::Mat> &framePtr, int64_t timestamp);
+
+    void startStream();
+
+    [[nodiscard]] bool isIdle();
+
+    void consumeSuperresFuturesTask();
+
+    void deliverFrame(std::optional<UpscaledFrame> &&upscaledFrame);
+
+    void rethrowTaskException();
+
+    double _upscaleFactor;
+    size_t _superresInstancesNumber;
+    std::vector<SuperRes> _superResArray; // Empty with a chain of models
+    std::unique_ptr<CascadeUpscaler> _cascadeUpscaler; // Frames go through a chain of models if set
+    std::vector<cv::Mat> _outputMats; // Output frames, one per superres instance
+    std::vector<int64_t> _outputTimestamps; // Timestamps of output frames
+    std::optional<HybridUpscaler> _hybridUpscaler; // Only detailed tiles go through the neural network if set
+    SceneAnalyzer _sceneAnalyzer; // Letterbox detection, only used in hybrid mode
+    std::optional<OutputCallback> _outputCallback;
+    size_t _outputQueueCapacity = DEFAULT_OUTPUT_QUEUE_CAPACITY;
+
+    std::thread _consumerSuperresFuturesThread; // Started on first push, serves every stream
+    bool _streamStarted = false; // Frames were pushed since the last finish()
+    bool _stopConsumer = false; // Destruction in progress, consumer thread returns once the tasks queue is empty
+    std::queue<std::optional<std::future<size_t>>> _waitingSuperresTasks; // Task that are waiting for getting their results
+    std::queue<size_t> _vacantSuperresAndOutputIds; // Ids of superres instances that are not currently working, also used for available output Mats
+    std::mutex _mtxSuperresTasks;
+    std::condition_variable _conditionVariableQueueOverflow, _conditionVariableQueueEmpty;
+
+    std::queue<std::optional<UpscaledFrame>> _upscaledFrames; // Frames waiting to be pulled, std::nullopt ends a stream
+    size_t _startedStreamsNumber = 0;
+    size_t _deliveredStreamsNumber = 0; // Streams whose every frame was given to the callback or the output queue
+    size_t _pulledStreamsNumber = 0; // Streams whose end was pulled
+    bool _discardOutput = false; // Destruction in progress, nobody will pull frames anymore
+    std::mutex _mtxUpscaledFrames;
+    std::condition_variable _conditionVariableOutputOverflow, _conditionVariableOutputEmpty;
+    std::condition_variable _conditionVariableStreamDelivered;
+
+    std::exception_ptr _taskException; // First exception thrown by an inference task
+    std::mutex _mtxTaskException;
+    std::atomic<unsigned long long> _dnnCoveredPixelsNumber{0}; // Active area pixels upscaled by the neural network
+    std::atomic<unsigned long long> _dnnInputPixelsNumber{0}; // Given to the neural network, tiles margins included
+    std::atomic<unsigned long long> _activePixelsNumber{0}; // Active area pixels processed
+};
+
+
+#endif //MOVIE_QUALITY_INCREASE_FRAMEUPSCALER_H
@@ -0,0 +1,201 @@
+#include <stdexcept>
+#include <algorithm>
+#include <vector>
+#include <array>
+#include <opencv2/imgproc.hpp>
+#include "HybridUpscaler.h"
+
+HybridUpscaler::HybridUpscaler(double detailThreshold) : _detailThreshold(detailThreshold)
+{
+}
+
+HybridUpscaler::DnnWorkload HybridUpscaler::upRes(SuperRes &superRes, const cv::Mat &input,
+                                                  const cv::Rect &activeArea, cv::Mat &output) const
+{
+    const unsigned short scale = superRes.getScale();
+    output.create(input.rows * scale, input.cols * scale, input.type());
+    FillLetterbox(input, activeArea, scale, output);
+
+    const cv::Mat activeInput = input(activeArea);
+    cv::Mat activeOutput = output(cv::Rect(activeArea.x * scale, activeArea.y * scale, activeArea.width * scale,
+                                           activeArea.height * scale));
+    cv::resize(activeInput, activeOutput, activeOutput.size(), 0, 0, cv::INTER_CUBIC); // Vectorized by OpenCV
+
+    const int tilesX = (activeInput.cols + _tileSize - 1) / _tileSize;
+    const int tilesY = (activeInput.rows + _tileSize - 1) / _tileSize;
+    const cv::Mat tilesDetail = computeTilesDetail(activeInput, tilesX, tilesY);
+
+    cv::Mat paddedInput; // Once padded, border tiles have the same size as the others
+    // Isolated, so that letterbox bars around the active area don't leak into the border tiles
+    cv::copyMakeBorder(activeInput, paddedInput, TILE_MARGIN, TILE_MARGIN + tilesY * _tileSize - activeInput.rows,
+                       TILE_MARGIN, TILE_MARGIN + tilesX * _tileSize - activeInput.cols,
+                       cv::BORDER_REFLECT_101 | cv::BORDER_ISOLATED);
+    const int tileInputSize = getTileInputSize();
+    const int tileOutputSize = tileInputSize * scale;
+    const cv::Rect accumulatorRect(0, 0, tilesX * _tileSize * scale, tilesY * _tileSize * scale);
+    cv::Mat accumulator, weights, tileOutput, tileOutputFloat;
+    std::array<cv::Mat, BLENDING_MASKS_NUMBER> blendingMasks; // Created on first use
+    const cv::Rect activeInputRect(0, 0, activeInput.cols, activeInput.rows);
+    DnnWorkload dnnWorkload{0, 0};
+    for (int tileY = 0; tileY < tilesY; ++tileY)
+    {
+        for (int tileX = 0; tileX < tilesX; ++tileX)
+        {
+            if (tilesDetail.at<uchar>(tileY, tileX) <= _detailThreshold) // Flat tile, bicubic is enough
+            {
+                continue;
+            }
+            if (accumulator.empty()) // First detailed tile of the frame
+            {
+                accumulator = cv::Mat::zeros(accumulatorRect.size(), CV_32FC(input.channels()));
+                weights = cv::Mat::zeros(accumulatorRect.size(), CV_32FC(input.channels()));
+            }
+            // Sides on the active area border have no neighbour tile to blend with
+            const size_t blendingMaskIndex = (tileX == 0 ? BLENDING_MASK_LEFT_BORDER : 0U) |
+                                             (tileY == 0 ? BLENDING_MASK_TOP_BORDER : 0U) |
+                                             (tileX == tilesX - 1 ? BLENDING_MASK_RIGHT_BORDER : 0U) |
+                                             (tileY == tilesY - 1 ? BLENDING_MASK_BOTTOM_BORDER : 0U);
+            cv::Mat &blendingMask = blendingMasks[blendingMaskIndex];
+            if (blendingMask.empty())
+            {
+                blendingMask = CreateBlendingMask(_tileSize, scale, input.channels(), blendingMaskIndex);
+            }
+            superRes.upRes(paddedInput(cv::Rect(tileX * _tileSize, tileY * _tileSize, tileInputSize, tileInputSize)),
+                           tileOutput);
+            tileOutput.convertTo(tileOutputFloat, CV_32F);
+            const cv::Rect tileOutputRect((tileX * _tileSize - TILE_MARGIN) * scale,
+                                          (tileY * _tileSize - TILE_MARGIN) * scale, tileOutputSize, tileOutputSize);
+            const cv::Rect destinationRect = tileOutputRect & accumulatorRect;
+            const cv::Rect sourceRect = destinationRect - tileOutputRect.tl();
+            cv::accumulateProduct(tileOutputFloat(sourceRect), blendingMask(sourceRect), accumulator(destinationRect));
+            cv::accumulate(blendingMask(sourceRect), weights(destinationRect));
+            // Border tiles cores are clipped, their padding does not count as covered
+            const cv::Rect tileCoreRect(tileX * _tileSize, tileY * _tileSize, _tileSize, _tileSize);
+            dnnWorkload.coveredPixelsNumber += (size_t) (tileCoreRect & activeInputRect).area();
+            dnnWorkload.inputPixelsNumber += (size_t) tileInputSize * tileInputSize;
+        }
+    }
+    if (accumulator.empty()) // Nothing went through the neural network
+    {
+        return dnnWorkload;
+    }
+
+    // output = (accumulator + bicubic * (1 - min(weights, 1))) / max(weights, 1)
+    const cv::Rect activeOutputRect(0, 0, activeOutput.cols, activeOutput.rows);
+    cv::Mat bicubicFloat, clampedWeights, blended;
+    activeOutput.convertTo(bicubicFloat, CV_32F);
+    cv::min(weights(activeOutputRect), cv::Scalar::all(1.0), clampedWeights);
+    cv::subtract(cv::Scalar::all(1.0), clampedWeights, clampedWeights);
+    cv::multiply(bicubicFloat, clampedWeights, bicubicFloat);
+    cv::add(accumulator(activeOutputRect), bicubicFloat, blended);
+    cv::max(weights(activeOutputRect), cv::Scalar::all(1.0), clampedWeights);
+    cv::divide(blended, clampedWeights, blended);
+    blended.convertTo(activeOutput, activeOutput.type());
+    return dnnWorkload;
+}
+
+double HybridUpscaler::getDetailThreshold() const
+{
+    return _detailThreshold;
+}
+
+void HybridUpscaler::setDetailThreshold(double detailThreshold)
+{
+    _detailThreshold = detailThreshold;
+}
+
+int HybridUpscaler::getTileSize() const
+{
+    return _tileSize;
+}
+
+void HybridUpscaler::setTileSize(int tileSize)
+{
+    if (tileSize <= 0)
+    {
+        throw std::invalid_argument("Tile size must be strictly positive");
+    }
+    _tileSize = tileSize;
+}
+
+int HybridUpscaler::getTileInputSize() const
+{
+    return _tileSize + 2 * TILE_MARGIN;
+}
+
+cv::Mat HybridUpscaler::computeTilesDetail(const cv::Mat &input, int tilesX, int tilesY) const
+{
+    cv::Mat gray, gradientX, gradientY, gradient;
+    if (input.channels() == 3)
+    {
+        cv::cvtColor(input, gray, cv::COLOR_BGR2GRAY);
+    } else if (input.channels() == 4)
+    {
+        cv::cvtColor(input, gray, cv::COLOR_BGRA2GRAY);
+    } else
+    {
+        gray = input;
+    }
+    // Isolated, gray may be the active area of a letterboxed frame and the bars edge is not detail
+    cv::Sobel(gray, gradientX, CV_16S, 1, 0, 3, 1.0, 0.0, cv::BORDER_REFLECT_101 | cv::BORDER_ISOLATED);
+    cv::Sobel(gray, gradientY, CV_16S, 0, 1, 3, 1.0, 0.0, cv::BORDER_REFLECT_101 | cv::BORDER_ISOLATED);
+    cv::convertScaleAbs(gradientX, gradientX);
+    cv::convertScaleAbs(gradientY, gradientY);
+    cv::addWeighted(gradientX, 0.5, gradientY, 0.5, 0.0, gradient);
+    cv::copyMakeBorder(gradient, gradient, 0, tilesY * _tileSize - gradient.rows, 0, tilesX * _tileSize - gradient.cols,
+                       cv::BORDER_REPLICATE);
+    cv::Mat tilesDetail; // Mean gradient of each tile
+    cv::resize(gradient, tilesDetail, cv::Size(tilesX, tilesY), 0, 0, cv::INTER_AREA);
+    return tilesDetail;
+}
+
+cv::Mat HybridUpscaler::CreateBlendingMask(int tileSize, unsigned short scale, int channels, size_t bordersFlags)
+{
+    const cv::Mat rampX = CreateBlendingRamp(tileSize, scale, bordersFlags & BLENDING_MASK_LEFT_BORDER,
+                                             bordersFlags & BLENDING_MASK_RIGHT_BORDER);
+    const cv::Mat rampY = CreateBlendingRamp(tileSize, scale, bordersFlags & BLENDING_MASK_TOP_BORDER,
+                                             bordersFlags & BLENDING_MASK_BOTTOM_BORDER);
+    cv::Mat mask = rampY.t() * rampX;
+    std::vector<cv::Mat> maskChannels(channels, mask);
+    cv::merge(maskChannels, mask);
+    return mask;
+}
+
+cv::Mat HybridUpscaler::CreateBlendingRamp(int tileSize, unsigned short scale, bool startOnBorder, bool endOnBorder)
+{
+    // Weight grows linearly over twice the margin, so that two overlapping tiles always sum to 1
+    const int tileOutputSize = (tileSize + 2 * TILE_MARGIN) * scale;
+    const float rampLength = 2.0f * (float) (TILE_MARGIN * scale);
+    cv::Mat ramp(1, tileOutputSize, CV_32F);
+    for (int i = 0; i < tileOutputSize; ++i)
+    {
+        const bool inStartHalf = i < tileOutputSize - 1 - i;
+        if ((inStartHalf && startOnBorder) || (!inStartHalf && endOnBorder)) // Nothing to blend with on this side
+        {
+            ramp.at<float>(i) = 1.0f;
+            continue;
+        }
+        float distanceToBorder = (float) std::min(i, tileOutputSize - 1 - i) + 0.5f;
+        ramp.at<float>(i) = std::min(1.0f, distanceToBorder / rampLength);
+    }
+    return ramp;
+}
+
+void HybridUpscaler::FillLetterbox(const cv::Mat &input, const cv::Rect &activeArea, unsigned short scale,
+                                   cv::Mat &output)
+{
+    if (activeArea.width == input.cols && activeArea.height == input.rows) // No letterbox
+    {
+        return;
+    }
+    cv::Mat barsMask(input.size(), CV_8U, cv::Scalar(255));
+    barsMask(activeArea).setTo(cv::Scalar(0));
+    const cv::Scalar barsColor = cv::mean(input, barsMask);
+    const cv::Rect activeOutputArea(activeArea.x * scale, activeArea.y * scale, activeArea.width * scale,
+                                    activeArea.height * scale);
+    output.rowRange(0, activeOutputArea.y).setTo(barsColor);
+    output.rowRange(activeOutputArea.br().y, output.rows).setTo(barsColor);
+    output(cv::Rect(0, activeOutputArea.y, activeOutputArea.x, activeOutputArea.height)).setTo(barsColor);
+    output(cv::Rect(activeOutputArea.br().x, activeOutputArea.y, output.cols - activeOutputArea.br().x,
+                    activeOutputArea.height)).setTo(barsColor);
+}
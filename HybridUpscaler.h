@@ -0,0 +1,108 @@
+#ifndef MOVIE_QUALITY_INCREASE_HYBRIDUPSCALER_H
+#define MOVIE_QUALITY_INCREASE_HYBRIDUPSCALER_H
+
+#include <opencv2/core.hpp>
+#include "SuperRes.h"
+
+class HybridUpscaler
+{
+public:
+    typedef struct
+    {
+        size_t coveredPixelsNumber; // Active area pixels in the cores of the tiles that went through the network
+        size_t inputPixelsNumber; // Pixels given to the neural network, tiles margins included
+    } DnnWorkload;
+
+    /**
+     * @brief Construct a new HybridUpscaler object with default detail threshold and tile size
+     */
+    HybridUpscaler() = default;
+
+    /**
+     * @brief Construct a new HybridUpscaler object
+     * @param detailThreshold Mean gradient magnitude (0 - 255) above which a tile goes through the neural network
+     */
+    explicit HybridUpscaler(double detailThreshold);
+
+    /**
+     * @brief Destroy the HybridUpscaler object
+     */
+    ~HybridUpscaler() = default;
+
+    /**
+     * @brief Upscale a frame, sending only detailed tiles to the neural network
+     * @param superRes Inference engine used on detailed tiles, its scale is used for the whole frame
+     * @param input Frame to upscale
+     * @param activeArea Area of the frame that is not covered by letterbox bars
+     * @param output Reference to the output frame
+     * @return Neural network workload of the frame, all zeros if no tile was detailed enough
+     * @note Other tiles are upscaled with bicubic interpolation and blended with neighbour tiles at their borders
+     * @note Letterbox bars are not upscaled, they are filled with their mean color
+     * @note Thread safe as long as each thread uses its own superRes instance
+     */
+    DnnWorkload upRes(SuperRes &superRes, const cv::Mat &input, const cv::Rect &activeArea, cv::Mat &output) const;
+
+    /**
+     * @brief Get the detail threshold
+     * @return Mean gradient magnitude (0 - 255) above which a tile goes through the neural network
+     */
+    [[nodiscard]] double getDetailThreshold() const;
+
+    /**
+     * @brief Set the detail threshold
+     * @param detailThreshold Mean gradient magnitude (0 - 255) above which a tile goes through the neural network
+     * @note 0 sends every non letterbox tile to the neural network
+     */
+    void setDetailThreshold(double detailThreshold);
+
+    /**
+     * @brief Get the tile size
+     * @return Tile width and height, in input pixels
+     */
+    [[nodiscard]] int getTileSize() const;
+
+    /**
+     * @brief Set the tile size
+     * @param tileSize Tile width and height, in input pixels
+     * @throw std::invalid_argument If tile size is not strictly positive
+     * @note Every tile has the same shape, so that the network is not reconfigured between tiles
+     */
+    void setTileSize(int tileSize);
+
+    /**
+     * @brief Get the size of the tiles given to the neural network, margins included
+     * @return Tile input width and height, in pixels
+     */
+    [[nodiscard]] int getTileInputSize() const;
+
+    static constexpr double DEFAULT_DETAIL_THRESHOLD = 8.0;
+
+    static constexpr int DEFAULT_TILE_SIZE = 64;
+
+    static constexpr int TILE_MARGIN = 8; // Overlap between tiles, in input pixels, used for blending
+
+private:
+    [[nodiscard]] cv::Mat computeTilesDetail(const cv::Mat &input, int tilesX, int tilesY) const;
+
+    static constexpr size_t BLENDING_MASK_LEFT_BORDER = 1U;
+
+    static constexpr size_t BLENDING_MASK_TOP_BORDER = 2U;
+
+    static constexpr size_t BLENDING_MASK_RIGHT_BORDER = 4U;
+
+    static constexpr size_t BLENDING_MASK_BOTTOM_BORDER = 8U;
+
+    static constexpr size_t BLENDING_MASKS_NUMBER = 16; // One per combination of sides on the active area border
+
+    static cv::Mat CreateBlendingMask(int tileSize, unsigned short scale, int channels, size_t bordersFlags);
+
+    static cv::Mat CreateBlendingRamp(int tileSize, unsigned short scale, bool startOnBorder, bool endOnBorder);
+
+    static void FillLetterbox(const cv::Mat &input, const cv::Rect &activeArea, unsigned short scale, cv::Mat &output);
+
+    double _detailThreshold = DEFAULT_DETAIL_THRESHOLD;
+    int _tileSize = DEFAULT_TILE_SIZE;
+};
+
+
+#endif //MOVIE_QUALITY_INCREASE_HYBRIDUPSCALER_H
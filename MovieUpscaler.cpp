@@ -1,11 +1,20 @@
 #include <stdexcept>
-#include <thread>
 #include <memory>
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <sstream>
+#include <cmath>
+#include <cstdlib>
 #include <opencv2/core/utils/logger.hpp>
+#include <opencv2/imgproc.hpp>
 #include "MovieUpscaler.h"
 
+constexpr std::string_view MODELS_TIMINGS_FILENAME = "cascade_timings.txt";
+constexpr std::string_view CACHE_DIRECTORY_NAME = "movie_quality_increase";
+
 MovieUpscaler::MovieUpscaler(std::string_view inputVideoFilename, std::string_view outputVideoFilename,
-                             unsigned short upscaleFactor, std::string_view modelsPath) : _inputVideoFilename(
+                             double upscaleFactor, std::string_view modelsPath) : _inputVideoFilename(
         inputVideoFilename),
                                                                                           _outputVideoFilename(
                                                                                                   outputVideoFilename),
@@ -34,12 +43,12 @@ MovieUpscaler::MovieUpscaler(std::string_view inputVideoFilename, std::string_vi
     _outputVideoFilename = outputVideoFilename;
 }
 
-[[maybe_unused]] unsigned short MovieUpscaler::getUpscaleFactor() const
+[[maybe_unused]] double MovieUpscaler::getUpscaleFactor() const
 {
     return _upscaleFactor;
 }
 
-[[maybe_unused]] void MovieUpscaler::setUpscaleFactor(unsigned short upscaleFactor)
+[[maybe_unused]] void MovieUpscaler::setUpscaleFactor(double upscaleFactor)
 {
     _upscaleFactor = upscaleFactor;
 }
@@ -64,7 +73,222 @@ MovieUpscaler::MovieUpscaler(std::string_view inputVideoFilename, std::string_vi
     _superresInstancesNumber = superresInstancesNumber;
 }
 
+[[maybe_unused]] std::optional<double> MovieUpscaler::getHybridDetailThreshold() const
+{
+    return _hybridDetailThreshold;
+}
+
+[[maybe_unused]] void MovieUpscaler::setHybridDetailThreshold(std::optional<double> hybridDetailThreshold)
+{
+    _hybridDetailThreshold = hybridDetailThreshold;
+}
+
+[[maybe_unused]] double MovieUpscaler::getDnnPixelsFraction() const
+{
+    return _dnnPixelsFraction;
+}
+
+[[maybe_unused]] double MovieUpscaler::getDnnMarginsOverhead() const
+{
+    return _dnnMarginsOverhead;
+}
+
+[[maybe_unused]] std::optional<CascadePlanner::Preference> MovieUpscaler::getCascadePreference() const
+{
+    return _cascadePreference;
+}
+
+[[maybe_unused]] void MovieUpscaler::setCascadePreference(std::optional<CascadePlanner::Preference> cascadePreference)
+{
+    _cascadePreference = cascadePreference;
+}
+
+[[maybe_unused]] const std::optional<CascadePlanner::Plan> &MovieUpscaler::getCascadePlan() const
+{
+    return _cascadePlan;
+}
+
+[[maybe_unused]] bool MovieUpscaler::getWarmUp() const
+{
+    return _warmUp;
+}
+
+[[maybe_unused]] void MovieUpscaler::setWarmUp(bool warmUp)
+{
+    _warmUp = warmUp;
+}
+
+[[maybe_unused]] const std::optional<std::string> &MovieUpscaler::getKernelCacheDirectory() const
+{
+    return _kernelCacheDirectory;
+}
+
+[[maybe_unused]] void MovieUpscaler::setKernelCacheDirectory(std::optional<std::string> kernelCacheDirectory)
+{
+    _kernelCacheDirectory = std::move(kernelCacheDirectory);
+}
+
+[[maybe_unused]] bool MovieUpscaler::getKernelAutoTuning() const
+{
+    return _kernelAutoTuning;
+}
+
+[[maybe_unused]] void MovieUpscaler::setKernelAutoTuning(bool kernelAutoTuning)
+{
+    _kernelAutoTuning = kernelAutoTuning;
+}
+
+[[maybe_unused]] const std::optional<std::string> &MovieUpscaler::getTimingsDirectory() const
+{
+    return _timingsDirectory;
+}
+
+[[maybe_unused]] void MovieUpscaler::setTimingsDirectory(std::optional<std::string> timingsDirectory)
+{
+    _timingsDirectory = std::move(timingsDirectory);
+}
+
+[[maybe_unused]] double MovieUpscaler::getWarmUpDuration() const
+{
+    return _warmUpDuration.count();
+}
+
+[[maybe_unused]] std::optional<double> MovieUpscaler::getTimeToFirstFrame() const
+{
+    if (!_timeToFirstFrame.has_value())
+    {
+        return std::nullopt;
+    }
+    return _timeToFirstFrame->count();
+}
+
+[[maybe_unused]] size_t MovieUpscaler::getStartFrame() const
+{
+    return _startFrame;
+}
+
+[[maybe_unused]] std::optional<size_t> MovieUpscaler::getEndFrame() const
+{
+    return _endFrame;
+}
+
+[[maybe_unused]] void MovieUpscaler::setFrameRange(size_t startFrame, std::optional<size_t> endFrame)
+{
+    if (endFrame.has_value() && endFrame.value() <= startFrame)
+    {
+        throw std::invalid_argument("End frame must be after start frame");
+    }
+    _startFrame = startFrame;
+    _endFrame = endFrame;
+}
+
+[[maybe_unused]] VideoEncoder &MovieUpscaler::getVideoEncoder()
+{
+    return _videoEncoder;
+}
+
+[[maybe_unused]] std::vector<VideoEncoder::BenchmarkResult> MovieUpscaler::benchmarkEncoders(size_t framesNumber)
+{
+    VideoInformations inputVideoInformations = openInputVideo();
+    if (_startFrame > 0 && !_inputVideoCapture.set(cv::CAP_PROP_POS_FRAMES, (double) _startFrame))
+    {
+        throw std::invalid_argument("Could not seek to frame " + std::to_string(_startFrame));
+    }
+    std::vector<cv::Mat> upscaledFrames;
+    cv::Mat frame;
+    while (upscaledFrames.size() < framesNumber && _inputVideoCapture.read(frame))
+    {
+        upscaledFrames.emplace_back();
+        cv::resize(frame, upscaledFrames.back(), cv::Size(), _upscaleFactor, _upscaleFactor, cv::INTER_CUBIC);
+    }
+    _inputVideoCapture.release();
+    return VideoEncoder::Benchmark(upscaledFrames, inputVideoInformations.fps,
+                                   std::filesystem::temp_directory_path().string());
+}
+
 [[maybe_unused]] void MovieUpscaler::run(const std::optional<std::function<bool(const size_t &)>> &progressCallback)
+{
+    _runBeginTime = std::chrono::steady_clock::now();
+    VideoInformations inputVideoInformations = openInputVideo();
+    std::unique_ptr<FrameUpscaler> frameUpscaler = createFrameUpscaler(inputVideoInformations);
+    openOutputVideo(inputVideoInformations, *frameUpscaler);
+
+    upscaleFrames(*frameUpscaler, _startFrame, _endFrame, progressCallback);
+
+    _dnnPixelsFraction = frameUpscaler->getDnnPixelsFraction();
+    _dnnMarginsOverhead = frameUpscaler->getDnnMarginsOverhead();
+    _inputVideoCapture.release();
+    _videoEncoder.close();
+}
+
+[[maybe_unused]] MovieUpscaler::PreviewEstimation
+MovieUpscaler::preview(size_t clipsNumber, size_t clipFramesNumber,
+                       const std::optional<std::function<bool(const size_t &)>> &progressCallback)
+{
+    if (clipsNumber == 0 || clipFramesNumber == 0)
+    {
+        throw std::invalid_argument("Preview needs at least one clip of one frame");
+    }
+    _runBeginTime = std::chrono::steady_clock::now();
+    VideoInformations inputVideoInformations = openInputVideo();
+    size_t endFrame = _endFrame.value_or(inputVideoInformations.framesNumber);
+    if (endFrame <= _startFrame)
+    {
+        throw std::invalid_argument("Unknown video length, an end frame must be set for preview");
+    }
+    size_t rangeFramesNumber = endFrame - _startFrame;
+    clipsNumber = std::min(clipsNumber, rangeFramesNumber);
+    clipFramesNumber = std::min(clipFramesNumber, rangeFramesNumber / clipsNumber); // Clips must not overlap
+
+    std::unique_ptr<FrameUpscaler> frameUpscaler = createFrameUpscaler(inputVideoInformations);
+    openOutputVideo(inputVideoInformations, *frameUpscaler);
+
+    size_t previewFramesNumber = 0, measuredFramesNumber = 0;
+    std::chrono::duration<double> measuredDuration(0.0);
+    for (size_t clip = 0; clip < clipsNumber; ++clip)
+    {
+        size_t clipStartFrame = _startFrame + clip * rangeFramesNumber / clipsNumber; // Evenly spread over the range
+        size_t clipUpscaledFrames = upscaleFrames(*frameUpscaler, clipStartFrame, clipStartFrame + clipFramesNumber,
+                                                  progressCallback);
+        auto clipEndTime = std::chrono::steady_clock::now();
+        // Seek and keyframe decoding happen once per clip but only once in a full run, so they are not measured
+        std::chrono::duration<double> clipDuration = clipEndTime - _firstFrameReadTime.value_or(clipEndTime);
+        previewFramesNumber += clipUpscaledFrames;
+        if (clip > 0 || _warmUp) // Without warm-up, first clip also pays the network setup
+        {
+            measuredFramesNumber += clipUpscaledFrames;
+            measuredDuration += clipDuration;
+        } else if (clipsNumber == 1 || clipUpscaledFrames < clipFramesNumber)
+        {
+            measuredFramesNumber = clipUpscaledFrames; // Nothing better to measure
+            measuredDuration = clipDuration;
+        }
+        if (clipUpscaledFrames < clipFramesNumber) // Stopped by callback, or end of video
+        {
+            break;
+        }
+    }
+
+    _dnnPixelsFraction = frameUpscaler->getDnnPixelsFraction();
+    _dnnMarginsOverhead = frameUpscaler->getDnnMarginsOverhead();
+    _inputVideoCapture.release();
+    _videoEncoder.close();
+    if (previewFramesNumber == 0 || measuredFramesNumber == 0)
+    {
+        throw std::runtime_error("No frame could be upscaled for preview");
+    }
+    double framesPerSecond = (double) measuredFramesNumber / measuredDuration.count();
+    return PreviewEstimation{
+            .previewFramesNumber = previewFramesNumber,
+            .framesPerSecond = framesPerSecond,
+            .projectedFramesNumber = rangeFramesNumber,
+            .projectedDurationSeconds = (double) rangeFramesNumber / framesPerSecond,
+            .projectedOutputSize = (unsigned long long) ((double) std::filesystem::file_size(_outputVideoFilename) *
+                                                         (double) rangeFramesNumber / (double) previewFramesNumber)
+    };
+}
+
+MovieUpscaler::VideoInformations MovieUpscaler::openInputVideo()
 {
     cv::utils::logging::setLogLevel(cv::utils::logging::LogLevel::LOG_LEVEL_SILENT); // Avoid OpenCV logs
     if (!checkInitialized())
@@ -76,74 +300,135 @@ MovieUpscaler::MovieUpscaler(std::string_view inputVideoFilename, std::string_vi
     {
         throw std::invalid_argument("Could not open input video file: " + _inputVideoFilename);
     }
+    return GetVideoInformations(_inputVideoCapture);
+}
 
-    VideoInformations inputVideoInformations = GetVideoInformations(_inputVideoCapture);
-
-    initiateTaskAndIdQueues(); // Fill id queues and clear task queue
+void MovieUpscaler::openOutputVideo(const VideoInformations &inputVideoInformations,
+                                    const FrameUpscaler &frameUpscaler)
+{
+    _videoEncoder.open(_outputVideoFilename, inputVideoInformations.fps, frameUpscaler.getOutputSize(
+            cv::Size(inputVideoInformations.width, inputVideoInformations.height)));
+}
 
-    std::vector<SuperRes> superResArray(_superresInstancesNumber);
+bool MovieUpscaler::usesCascade() const
+{
+    // Range is checked before the cast, which is undefined for values out of unsigned short range
+    return _cascadePreference.has_value() || _upscaleFactor != std::floor(_upscaleFactor) ||
+           !(_upscaleFactor >= 1.0 && _upscaleFactor <= CascadePlanner::MAX_UPSCALE_FACTOR) ||
+           !SuperRes::IsScaleSupported(DEFAULT_SUPERRES_ALGO, (unsigned short) _upscaleFactor);
+}
 
-    for (size_t i = 0; i < _superresInstancesNumber; i++)
+std::unique_ptr<FrameUpscaler> MovieUpscaler::createFrameUpscaler(const VideoInformations &inputVideoInformations)
+{
+    const cv::Size frameSize(inputVideoInformations.width, inputVideoInformations.height);
+    // Before models loading and timing, which already use OpenCL
+    enableKernelCache(FrameUpscaler::GetNetworkInputSize(frameSize, _hybridDetailThreshold));
+    std::unique_ptr<FrameUpscaler> frameUpscaler;
+    _cascadePlan.reset();
+    if (usesCascade())
+    {
+        CascadePlanner cascadePlanner(_modelsPath);
+        std::optional<std::filesystem::path> timingsFilePath;
+        if (_timingsDirectory.has_value())
+        {
+            timingsFilePath = std::filesystem::path(_timingsDirectory.value()) / MODELS_TIMINGS_FILENAME;
+            cascadePlanner.loadTimings(timingsFilePath->string());
+        }
+        _cascadePlan = cascadePlanner.plan(_upscaleFactor,
+                                           _cascadePreference.value_or(CascadePlanner::DEFAULT_PREFERENCE));
+        std::error_code errorCode;
+        if (timingsFilePath.has_value() && // An unwritable cache only costs the timing again on next run
+            (std::filesystem::create_directories(_timingsDirectory.value(), errorCode) || !errorCode))
+        {
+            cascadePlanner.saveTimings(timingsFilePath->string());
+        }
+        frameUpscaler = std::make_unique<FrameUpscaler>(_modelsPath, _cascadePlan.value(), _superresInstancesNumber);
+    } else
+    {
+        frameUpscaler = std::make_unique<FrameUpscaler>(_modelsPath, (unsigned short) _upscaleFactor,
+                                                        _superresInstancesNumber);
+    }
+    frameUpscaler->setHybridDetailThreshold(_hybridDetailThreshold);
+    _timeToFirstFrame.reset();
+    frameUpscaler->setOutputCallback([this](FrameUpscaler::UpscaledFrame &&upscaledFrame) {
+        if (!_timeToFirstFrame.has_value())
+        {
+            _timeToFirstFrame = std::chrono::steady_clock::now() - _runBeginTime;
+        }
+        _videoEncoder.write(std::move(upscaledFrame.frame));
+    });
+    _warmUpDuration = std::chrono::duration<double>(0.0);
+    if (_warmUp)
     {
-        superResArray[i].setModelFolderPath(_modelsPath);
-        superResArray[i].setAlgoAndScale(DEFAULT_SUPERRES_ALGO, _upscaleFactor);
+        auto warmUpBeginTime = std::chrono::steady_clock::now();
+        frameUpscaler->warmUp(frameSize);
+        _warmUpDuration = std::chrono::steady_clock::now() - warmUpBeginTime;
     }
+    return frameUpscaler;
+}
 
-    std::vector<cv::Mat> outputMats(_superresInstancesNumber); // Output frames
+void MovieUpscaler::enableKernelCache(const cv::Size &networkInputSize) const
+{
+    if (_kernelCacheDirectory.has_value())
+    {
+        std::filesystem::path cacheDirectory = std::filesystem::path(_kernelCacheDirectory.value()) /
+                                               getKernelCacheKey(networkInputSize);
+        SuperRes::EnableKernelCache(cacheDirectory.string(), _kernelAutoTuning);
+    }
+}
 
-    if (!_outputVideoWriter.open(_outputVideoFilename, cv::VideoWriter::fourcc('A', 'V', 'C', '1'),
-                                 inputVideoInformations.fps,
-                                 cv::Size(inputVideoInformations.width * _upscaleFactor,
-                                          inputVideoInformations.height * _upscaleFactor)))
+std::string MovieUpscaler::getKernelCacheKey(const cv::Size &networkInputSize) const
+{
+    std::string networkInputShape = std::to_string(networkInputSize.width) + "x" +
+                                    std::to_string(networkInputSize.height);
+    if (usesCascade())
     {
-        throw std::invalid_argument("Could not open output video file: " + _outputVideoFilename);
+        std::ostringstream cascadeName;
+        CascadePlanner::Preference preference = _cascadePreference.value_or(CascadePlanner::DEFAULT_PREFERENCE);
+        cascadeName << "cascade_x" << _upscaleFactor << "_" << CascadePlanner::GetPreferenceName(preference);
+        return cascadeName.str() + "_" + networkInputShape;
     }
+    return SuperRes::GetModelName(DEFAULT_SUPERRES_ALGO, (unsigned short) _upscaleFactor) + "_" + networkInputShape;
+}
 
-    // Write output frames to video
-    std::thread consumerSuperresFuturesThread(&MovieUpscaler::consumeSuperresFuturesTask, this,
-                                              std::ref(_outputVideoWriter), std::ref(outputMats));
+size_t MovieUpscaler::upscaleFrames(FrameUpscaler &frameUpscaler, size_t firstFrame, std::optional<size_t> endFrame,
+                                    const std::optional<std::function<bool(const size_t &)>> &progressCallback)
+{
+    // Seek instead of decoding and discarding frames, ffmpeg restarts decoding from the closest keyframe
+    if ((size_t) _inputVideoCapture.get(cv::CAP_PROP_POS_FRAMES) != firstFrame &&
+        !_inputVideoCapture.set(cv::CAP_PROP_POS_FRAMES, (double) firstFrame))
+    {
+        throw std::invalid_argument("Could not seek to frame " + std::to_string(firstFrame));
+    }
 
-    for (unsigned long long numFrame = 0;; ++numFrame)
+    _firstFrameReadTime.reset();
+    size_t numFrame = firstFrame;
+    for (; !endFrame.has_value() || numFrame < endFrame.value(); ++numFrame)
     {
         bool callbackShouldContinue = true; // Callback requested stop ?
         if (progressCallback.has_value())
         {
             callbackShouldContinue = progressCallback.value()(numFrame);
         }
-        std::shared_ptr<cv::Mat> framePtr = std::make_shared<cv::Mat>();
-        if (!_inputVideoCapture.read(*framePtr) || !callbackShouldContinue)
+        cv::Mat frame;
+        if (!callbackShouldContinue || !_inputVideoCapture.read(frame))
         {
-            _waitingSuperresTasks.push(std::nullopt); // Tell writer thread to stop
             break;
         }
-        if (_waitingSuperresTasks.size() >= _superresInstancesNumber ||
-            _vacantSuperresAndOutputIds.empty()) // Wait until there is an available output and superres task
+        if (!_firstFrameReadTime.has_value())
         {
-            std::unique_lock<std::mutex> lckQueueOverflow(_mtxQueueOverflow);
-            _conditionVariableQueueOverflow.wait(lckQueueOverflow, [&]() -> bool {
-                return _waitingSuperresTasks.size() < _superresInstancesNumber && !_vacantSuperresAndOutputIds.empty();
-            });
+            _firstFrameReadTime = std::chrono::steady_clock::now();
         }
-        size_t superresId = _vacantSuperresAndOutputIds.front(); // First available superres and output frame
-        _vacantSuperresAndOutputIds.pop();
-        std::unique_lock<std::mutex> lckQueueEmpty(_mtxQueueEmpty);
-        _waitingSuperresTasks.emplace(std::optional<std::future<size_t>>(
-                std::async(std::launch::async,
-                           [&superResArray, &outputMats, superresId, framePtr]() -> size_t {
-                               superResArray[superresId].upRes(*framePtr, outputMats[superresId]);
-                               return superresId;
-                           }))); // Add new task to superrres a frame
-        _conditionVariableQueueEmpty.notify_one(); // If queue was empty, no longer empty
-    }
-
-    consumerSuperresFuturesThread.join(); // All frames are written to video before closing the video writer
-    _inputVideoCapture.release();
-    _outputVideoWriter.release();
+        frameUpscaler.push(std::move(frame), (int64_t) numFrame);
+    }
+    frameUpscaler.finish(); // All frames are given to the encoder before returning
+    return numFrame - firstFrame;
 }
 
 bool MovieUpscaler::checkInitialized() const
 {
-    return !_inputVideoFilename.empty() && !_outputVideoFilename.empty() && _upscaleFactor != 0 && !_modelsPath.empty();
+    return !_inputVideoFilename.empty() && !_outputVideoFilename.empty() && _upscaleFactor >= 1.0 &&
+           _upscaleFactor <= CascadePlanner::MAX_UPSCALE_FACTOR && !_modelsPath.empty();
 }
 
 MovieUpscaler::VideoInformations MovieUpscaler::GetVideoInformations(const cv::VideoCapture &inputVideo)
@@ -151,42 +436,22 @@ MovieUpscaler::VideoInformations MovieUpscaler::GetVideoInformations(const cv::V
     return VideoInformations{
             .width =  (unsigned short) inputVideo.get(cv::CAP_PROP_FRAME_WIDTH),
             .height =  (unsigned short) inputVideo.get(cv::CAP_PROP_FRAME_HEIGHT),
-            .fps =  inputVideo.get(cv::CAP_PROP_FPS)
+            .fps =  inputVideo.get(cv::CAP_PROP_FPS),
+            .framesNumber = (size_t) std::max(0.0, inputVideo.get(cv::CAP_PROP_FRAME_COUNT))
     };
 }
 
-void MovieUpscaler::consumeSuperresFuturesTask(cv::VideoWriter &videoWriter, const std::vector<cv::Mat> &outputMats)
+std::optional<std::string> MovieUpscaler::GetUserCacheDirectory()
 {
-    bool videoFinished = false;
-    while (!videoFinished) // Task != std::nullopt
+    const char *cacheHome = std::getenv("XDG_CACHE_HOME");
+    if (cacheHome != nullptr && *cacheHome != '\0')
     {
-        if (_waitingSuperresTasks.empty()) // No superres taskOutputFrameId available
-        {
-            std::unique_lock<std::mutex> lckQueueEmpty(_mtxQueueEmpty);
-            _conditionVariableQueueEmpty.wait(lckQueueEmpty, [&]() -> bool { return !_waitingSuperresTasks.empty(); });
-        }
-        std::optional<std::future<size_t>> &taskOutputFrameId = _waitingSuperresTasks.front(); // Task will return output frame id
-        if (taskOutputFrameId.has_value())
-        {
-            size_t superresAndOutputId = taskOutputFrameId.value().get(); // Wait until taskOutputFrameId is finished
-            videoWriter.write(outputMats[superresAndOutputId]);
-            _vacantSuperresAndOutputIds.push(superresAndOutputId); // Can reuse output frame
-        } else // No more taskOutputFrameId
-        {
-            videoFinished = true;
-        }
-        std::unique_lock<std::mutex> lckQueueOverflow(_mtxQueueOverflow);
-        _waitingSuperresTasks.pop(); // Task is no longer waiting
-        _conditionVariableQueueOverflow.notify_one();
+        return (std::filesystem::path(cacheHome) / CACHE_DIRECTORY_NAME).string();
     }
-}
-
-void MovieUpscaler::initiateTaskAndIdQueues()
-{
-    ClearQueue(_vacantSuperresAndOutputIds);
-    ClearQueue(_waitingSuperresTasks);
-    for (size_t i = 0; i < _superresInstancesNumber; ++i)
+    const char *home = std::getenv("HOME");
+    if (home != nullptr && *home != '\0')
     {
-        _vacantSuperresAndOutputIds.push(i);
+        return (std::filesystem::path(home) / ".cache" / CACHE_DIRECTORY_NAME).string();
     }
-}
+    return std::nullopt;
+}
\ No newline at end of file
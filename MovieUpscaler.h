@@ -4,14 +4,15 @@
 #include <string>
 #include <string_view>
 #include <vector>
-#include <queue>
-#include <future>
 #include <optional>
 #include <functional>
-#include <mutex>
-#include <condition_variable>
+#include <memory>
+#include <chrono>
 #include <opencv2/videoio.hpp>
 #include "SuperRes.h"
+#include "FrameUpscaler.h"
+#include "CascadePlanner.h"
+#include "VideoEncoder.h"
 
 class MovieUpscaler
 {
@@ -25,14 +26,15 @@ public:
     /**
      * @brief Initialize the MovieUpscaler object
      * @param inputVideoFilename Filename of the input video, must be readable by ffmpeg
-     * @param outputVideoFilename Filename of the output video, encoded with AVC1 (file should be .mp4)
-     * @param upscaleFactor Video upscale factor (1, 2, 3, 4, 8, depending on the model)
+     * @param outputVideoFilename Filename of the output video, encoded with AVC1 by default (file should be .mp4)
+     * @param upscaleFactor Video upscale factor, between 1 and CascadePlanner::MAX_UPSCALE_FACTOR, factors other than 2,
+     * 3 and 4 use a chain of models
      * @param modelsPath Path to the models folder
      * @note Models folder must contain the following subfolders:
      * EDSR, ESPCN, FSRCNN, LapSRN.
      */
     MovieUpscaler(std::string_view inputVideoFilename, std::string_view outputVideoFilename,
-                  unsigned short upscaleFactor, std::string_view modelsPath);
+                  double upscaleFactor, std::string_view modelsPath);
 
     MovieUpscaler(const MovieUpscaler &other) = delete; // Disallow copy
 
@@ -64,7 +66,7 @@ public:
     /**
      * @brief Set the output video filename
      * @param outputVideoFilename Output video filename
-     * @note Output video filename will be encoded with AVC1 (file should be .mp4)
+     * @note Extension must match a container supporting the encoder codec (.mp4 for default AVC1)
      */
     [[maybe_unused]] void setOutputVideoFilename(std::string_view outputVideoFilename);
 
@@ -72,13 +74,15 @@ public:
      * @brief Get video upscale factor
      * @return Upscale factor
      */
-    [[maybe_unused]] [[nodiscard]] unsigned short getUpscaleFactor() const;
+    [[maybe_unused]] [[nodiscard]] double getUpscaleFactor() const;
 
     /**
      * @brief Set the video upscale factor
-     * @param upscaleFactor Upscale factor for the video, depending on the model (1, 2, 3, 4, 8)
+     * @param upscaleFactor Upscale factor for the video, between 1 and CascadePlanner::MAX_UPSCALE_FACTOR, may be
+     * non-integer
+     * @note Factors other than 2, 3 and 4 use a chain of models, see setCascadePreference()
      */
-    [[maybe_unused]] void setUpscaleFactor(unsigned short upscaleFactor);
+    [[maybe_unused]] void setUpscaleFactor(double upscaleFactor);
 
     /**
      * @brief Get models path
@@ -96,18 +100,80 @@ public:
      */
     [[maybe_unused]] void setModelsPath(std::string_view modelsPath);
 
+    /**
+     * @brief Get the first frame to upscale
+     * @return First frame number, 0 by default
+     */
+    [[maybe_unused]] [[nodiscard]] size_t getStartFrame() const;
+
+    /**
+     * @brief Get the frame after the last frame to upscale
+     * @return End frame number, std::nullopt to upscale until the end of the video
+     */
+    [[maybe_unused]] [[nodiscard]] std::optional<size_t> getEndFrame() const;
+
+    /**
+     * @brief Set the range of frames to upscale
+     * @param startFrame First frame to upscale, reached by seeking in the input video
+     * @param endFrame Frame after the last frame to upscale, std::nullopt to upscale until the end of the video
+     * @throw std::invalid_argument If end frame is not after start frame
+     */
+    [[maybe_unused]] void setFrameRange(size_t startFrame, std::optional<size_t> endFrame = std::nullopt);
+
     /**
      * @brief Run the MovieUpscaler
      * @param Optional callback function to be called after each frame is read and before it is written
-     * @note Callback function takes as argument the current frame number
+     * @note Callback function takes as argument the current frame number in the input video
+     * @note Only frames in the range set by setFrameRange() are upscaled
      * @note If callback function returns false, the MovieUpscaler will stop
      */
     [[maybe_unused]] void
     run(const std::optional<std::function<bool(const size_t &)>> &progressCallback = std::nullopt);
 
-    static constexpr size_t DEFAULT_SUPERRES_INSTANCES_NUMBER = 8; // 8 simultaneous inference instances by default, reduce if you run out of memory
+    /**
+     * @brief Get the output video encoder
+     * @return Encoder reference, to configure codec and encoder parameters before running
+     * @note Encode throughput of the last run is available from the encoder
+     */
+    [[maybe_unused]] VideoEncoder &getVideoEncoder();
+
+    /**
+     * @brief Measure the encoding throughput of every codec on the upscaled frame size
+     * @param framesNumber Number of frames read from the start frame, upscaled with bicubic interpolation
+     * @return Encoding throughput and mean encoded frame size for each codec
+     */
+    [[maybe_unused]] std::vector<VideoEncoder::BenchmarkResult> benchmarkEncoders(size_t framesNumber);
+
+    typedef struct
+    {
+        size_t previewFramesNumber; // Frames written to the preview output video
+        double framesPerSecond; // Measured upscale throughput
+        size_t projectedFramesNumber; // Frames that a full run would upscale
+        double projectedDurationSeconds; // Projected duration of a full run
+        unsigned long long projectedOutputSize; // Projected output video size of a full run, in bytes
+    } PreviewEstimation;
+
+    /**
+     * @brief Upscale short clips evenly sampled across the frame range, and estimate a full run
+     * @param clipsNumber Number of clips to sample
+     * @param clipFramesNumber Number of frames of each clip
+     * @param progressCallback Same as run()
+     * @return Measured throughput and projected full run duration and output size
+     * @throw std::invalid_argument If the video length is unknown and no end frame is set
+     * @note Clips are concatenated in the output video, so that the result can be checked
+     * @note Each clip is timed from its first read frame, so that seeking is not counted as upscaling time
+     * @note Without warm-up, the first clip is not taken into account for throughput when there are several clips,
+     * as it includes the inference engines setup
+     */
+    [[maybe_unused]] PreviewEstimation
+    preview(size_t clipsNumber, size_t clipFramesNumber = DEFAULT_PREVIEW_CLIP_FRAMES_NUMBER,
+            const std::optional<std::function<bool(const size_t &)>> &progressCallback = std::nullopt);
+
+    static constexpr size_t DEFAULT_PREVIEW_CLIP_FRAMES_NUMBER = 48; // 2 seconds for most movies
+
+    static constexpr size_t DEFAULT_SUPERRES_INSTANCES_NUMBER = FrameUpscaler::DEFAULT_SUPERRES_INSTANCES_NUMBER;
 
-    static constexpr SuperRes::Algo DEFAULT_SUPERRES_ALGO = SuperRes::Algo::ESPCN; // Should not be changed, because it's the best for movies
+    static constexpr SuperRes::Algo DEFAULT_SUPERRES_ALGO = FrameUpscaler::DEFAULT_SUPERRES_ALGO;
 
     /**
      * @brief Get the number of concurrent inference instances
@@ -123,38 +189,172 @@ public:
      */
     [[maybe_unused]] void setSuperresInstancesNumber(size_t superresInstancesNumber);
 
+    /**
+     * @brief Get the hybrid upscaling detail threshold
+     * @return Detail threshold, std::nullopt if every pixel goes through the neural network
+     */
+    [[maybe_unused]] [[nodiscard]] std::optional<double> getHybridDetailThreshold() const;
+
+    /**
+     * @brief Enable or disable hybrid upscaling
+     * @param hybridDetailThreshold Mean gradient magnitude (0 - 255) above which a tile goes through the neural network,
+     * std::nullopt to send every pixel to the neural network
+     * @note In hybrid mode flat tiles are upscaled with bicubic interpolation and letterbox bars are skipped
+     */
+    [[maybe_unused]] void setHybridDetailThreshold(std::optional<double> hybridDetailThreshold);
+
+    /**
+     * @brief Get the chain of models preference
+     * @return Preference, std::nullopt if a single model is used when it supports the upscale factor
+     */
+    [[maybe_unused]] [[nodiscard]] std::optional<CascadePlanner::Preference> getCascadePreference() const;
+
+    /**
+     * @brief Upscale through a chain of models chosen by CascadePlanner
+     * @param cascadePreference Trade-off between speed and quality, std::nullopt to use a single model when it supports
+     * the upscale factor
+     * @note Upscale factors not supported by a single model always use a chain, with the default preference
+     * @note Models are timed before the first frame, to estimate the cost of every chain
+     * @note Hybrid upscaling is not available with a chain of models
+     */
+    [[maybe_unused]] void setCascadePreference(std::optional<CascadePlanner::Preference> cascadePreference);
+
+    /**
+     * @brief Get the chain of models used during last run
+     * @return Plan, std::nullopt if a single model was used
+     */
+    [[maybe_unused]] [[nodiscard]] const std::optional<CascadePlanner::Plan> &getCascadePlan() const;
+
+    /**
+     * @brief Tell whether inference instances are warmed up before upscaling
+     * @return True by default
+     */
+    [[maybe_unused]] [[nodiscard]] bool getWarmUp() const;
+
+    /**
+     * @brief Enable or disable inference instances warm up
+     * @param warmUp If true, every instance is primed in parallel on a dummy frame of the input size before upscaling
+     */
+    [[maybe_unused]] void setWarmUp(bool warmUp);
+
+    /**
+     * @brief Get the compiled kernels cache directory
+     * @return Cache directory, std::nullopt if kernels are not persisted
+     */
+    [[maybe_unused]] [[nodiscard]] const std::optional<std::string> &getKernelCacheDirectory() const;
+
+    /**
+     * @brief Persist compiled OpenCL programs and tuned DNN kernels between runs
+     * @param kernelCacheDirectory Cache directory, a subdirectory is used for each model and network input shape,
+     * std::nullopt to disable
+     * @note Only the first run of the process chooses the cache subdirectory, see SuperRes::EnableKernelCache()
+     */
+    [[maybe_unused]] void setKernelCacheDirectory(std::optional<std::string> kernelCacheDirectory);
+
+    /**
+     * @brief Get whether DNN kernels are tuned for the network input shape
+     * @return True if auto-tuning is enabled
+     */
+    [[maybe_unused]] [[nodiscard]] bool getKernelAutoTuning() const;
+
+    /**
+     * @brief Enable or disable DNN kernels auto-tuning
+     * @param kernelAutoTuning If true, kernels missing from the cache are tuned before the first inference
+     * @note Only effective with a kernel cache directory, so that tuning is paid once
+     */
+    [[maybe_unused]] void setKernelAutoTuning(bool kernelAutoTuning);
+
+    /**
+     * @brief Get the directory where the models timings of the chain planning are saved
+     * @return Timings directory, std::nullopt if models are timed on each run
+     */
+    [[maybe_unused]] [[nodiscard]] const std::optional<std::string> &getTimingsDirectory() const;
+
+    /**
+     * @brief Set the directory where the models timings of the chain planning are saved
+     * @param timingsDirectory Timings directory, created if needed, std::nullopt to time models on each run. Defaults
+     * to the user cache directory: $XDG_CACHE_HOME/movie_quality_increase, else ~/.cache/movie_quality_increase
+     * @note Timings depend on the inference target, so the directory must not be shared between machines
+     */
+    [[maybe_unused]] void setTimingsDirectory(std::optional<std::string> timingsDirectory);
+
+    /**
+     * @brief Get the warm up duration of last run
+     * @return Warm up duration in seconds, 0 if warm up is disabled
+     */
+    [[maybe_unused]] [[nodiscard]] double getWarmUpDuration() const;
+
+    /**
+     * @brief Get the time between the start of last run and the first encoded frame
+     * @return Time to first output frame in seconds, std::nullopt if no frame was output
+     * @note Includes models loading and warm up
+     */
+    [[maybe_unused]] [[nodiscard]] std::optional<double> getTimeToFirstFrame() const;
+
+    /**
+     * @brief Get the share of the frames upscaled by the neural network during last run
+     * @return Active area pixels covered by the neural network divided by the active area pixels, 0 if no frame has
+     * been processed
+     */
+    [[maybe_unused]] [[nodiscard]] double getDnnPixelsFraction() const;
+
+    /**
+     * @brief Get the neural network work spent on tiles margins during last run
+     * @return Pixels given to the neural network divided by the pixels it covered, minus 1
+     */
+    [[maybe_unused]] [[nodiscard]] double getDnnMarginsOverhead() const;
+
 private:
     typedef struct
     {
         unsigned short width; // Movie width, in pixels
         unsigned short height; // Movie height, in pixels
         double fps; // Frames per second, same in input and output
+        size_t framesNumber; // Number of frames announced by the container, 0 if unknown
     } VideoInformations;
 
     [[nodiscard]] bool checkInitialized() const; // Check if all needed parameters are set
     static VideoInformations GetVideoInformations(const cv::VideoCapture &inputVideo);
 
-    void consumeSuperresFuturesTask(cv::VideoWriter &videoWriter, const std::vector<cv::Mat> &outputMats);
+    static std::optional<std::string> GetUserCacheDirectory();
 
-    void initiateTaskAndIdQueues();
+    VideoInformations openInputVideo();
 
-    template<typename T>
-    void ClearQueue(std::queue<T> &queueToClear)
-    {
-        queueToClear = std::queue<T>();
-    }
+    void openOutputVideo(const VideoInformations &inputVideoInformations, const FrameUpscaler &frameUpscaler);
+
+    [[nodiscard]] bool usesCascade() const;
+
+    [[nodiscard]] std::unique_ptr<FrameUpscaler> createFrameUpscaler(const VideoInformations &inputVideoInformations);
+
+    void enableKernelCache(const cv::Size &networkInputSize) const;
+
+    [[nodiscard]] std::string getKernelCacheKey(const cv::Size &networkInputSize) const;
+
+    size_t upscaleFrames(FrameUpscaler &frameUpscaler, size_t firstFrame, std::optional<size_t> endFrame,
+                         const std::optional<std::function<bool(const size_t &)>> &progressCallback);
 
     std::string _inputVideoFilename;
     std::string _outputVideoFilename;
-    unsigned short _upscaleFactor = 0;
+    double _upscaleFactor = 0.0;
     std::string _modelsPath;
+    size_t _startFrame = 0;
+    std::optional<size_t> _endFrame;
     cv::VideoCapture _inputVideoCapture;
-    cv::VideoWriter _outputVideoWriter;
+    VideoEncoder _videoEncoder; // Encodes output frames in its own thread
     size_t _superresInstancesNumber = DEFAULT_SUPERRES_INSTANCES_NUMBER;
-    std::queue<std::optional<std::future<size_t>>> _waitingSuperresTasks; // Task that are waiting for getting their results
-    std::queue<size_t> _vacantSuperresAndOutputIds; // Ids of superres instances that are not currently working, also used for available output Mats
-    std::mutex _mtxQueueOverflow, _mtxQueueEmpty;
-    std::condition_variable _conditionVariableQueueOverflow, _conditionVariableQueueEmpty;
+    std::optional<double> _hybridDetailThreshold; // Only detailed tiles go through the neural network if set
+    std::optional<CascadePlanner::Preference> _cascadePreference;
+    std::optional<CascadePlanner::Plan> _cascadePlan; // Of last run
+    bool _warmUp = true;
+    std::optional<std::string> _kernelCacheDirectory;
+    bool _kernelAutoTuning = false;
+    std::optional<std::string> _timingsDirectory = GetUserCacheDirectory();
+    double _dnnPixelsFraction = 0.0; // Of last run
+    double _dnnMarginsOverhead = 0.0; // Of last run
+    std::chrono::steady_clock::time_point _runBeginTime;
+    std::chrono::duration<double> _warmUpDuration{0.0}; // Of last run
+    std::optional<std::chrono::duration<double>> _timeToFirstFrame; // Of last run
+    std::optional<std::chrono::steady_clock::time_point> _firstFrameReadTime; // Of last upscaleFrames() call
 };
 
 
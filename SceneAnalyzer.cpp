@@ -0,0 +1,93 @@
+#include <opencv2/imgproc.hpp>
+#include "SceneAnalyzer.h"
+
+constexpr int THUMBNAIL_WIDTH = 64;
+constexpr int THUMBNAIL_HEIGHT = 36;
+
+const cv::Rect &SceneAnalyzer::getActiveArea(const cv::Mat &frame)
+{
+    cv::Mat thumbnail;
+    cv::resize(frame, thumbnail, cv::Size(THUMBNAIL_WIDTH, THUMBNAIL_HEIGHT), 0, 0, cv::INTER_AREA);
+    bool newScene = _previousThumbnail.empty() || _previousThumbnail.type() != thumbnail.type() ||
+                    _frameSize != frame.size();
+    if (!newScene)
+    {
+        double meanDifference = cv::norm(thumbnail, _previousThumbnail, cv::NORM_L1) /
+                                (double) (thumbnail.total() * thumbnail.channels());
+        newScene = meanDifference > SCENE_CUT_THRESHOLD;
+    }
+    _previousThumbnail = thumbnail;
+    _frameSize = frame.size();
+    if (newScene)
+    {
+        ++_scenesNumber;
+        _activeArea = DetectActiveArea(frame);
+    } else if (!barsAreStillDark(frame)) // Slow fade in or subtitles in the bars, picture grew without a cut
+    {
+        _activeArea = DetectActiveArea(frame);
+    }
+    return _activeArea;
+}
+
+size_t SceneAnalyzer::getScenesNumber() const
+{
+    return _scenesNumber;
+}
+
+void SceneAnalyzer::reset()
+{
+    _previousThumbnail.release();
+    _activeArea = cv::Rect();
+    _frameSize = cv::Size();
+    _scenesNumber = 0;
+}
+
+cv::Rect SceneAnalyzer::DetectActiveArea(const cv::Mat &frame)
+{
+    cv::Mat rowsMax, colsChannelsMax, colsMax; // Brightest value of each row / column, all channels together
+    cv::reduce(frame.reshape(1, frame.rows), rowsMax, 1, cv::REDUCE_MAX);
+    cv::reduce(frame.reshape(1, frame.rows), colsChannelsMax, 0, cv::REDUCE_MAX);
+    cv::reduce(colsChannelsMax.reshape(1, frame.cols), colsMax, 1, cv::REDUCE_MAX);
+
+    int top = 0, bottom = frame.rows, left = 0, right = frame.cols;
+    while (top < bottom && rowsMax.at<uchar>(top) <= LETTERBOX_MAX_LEVEL)
+    {
+        ++top;
+    }
+    while (bottom > top && rowsMax.at<uchar>(bottom - 1) <= LETTERBOX_MAX_LEVEL)
+    {
+        --bottom;
+    }
+    while (left < right && colsMax.at<uchar>(left) <= LETTERBOX_MAX_LEVEL)
+    {
+        ++left;
+    }
+    while (right > left && colsMax.at<uchar>(right - 1) <= LETTERBOX_MAX_LEVEL)
+    {
+        --right;
+    }
+    if (top == bottom || left == right) // Black frame, nothing to skip
+    {
+        return {0, 0, frame.cols, frame.rows};
+    }
+    return {left, top, right - left, bottom - top};
+}
+
+bool SceneAnalyzer::IsDark(const cv::Mat &frameArea)
+{
+    if (frameArea.empty())
+    {
+        return true;
+    }
+    double maxValue = 0.0;
+    cv::minMaxLoc(frameArea.reshape(1), nullptr, &maxValue);
+    return maxValue <= LETTERBOX_MAX_LEVEL;
+}
+
+bool SceneAnalyzer::barsAreStillDark(const cv::Mat &frame) const
+{
+    return IsDark(frame.rowRange(0, _activeArea.y)) && IsDark(frame.rowRange(_activeArea.br().y, frame.rows)) &&
+           IsDark(frame(cv::Rect(0, _activeArea.y, _activeArea.x, _activeArea.height))) &&
+           IsDark(frame(cv::Rect(_activeArea.br().x, _activeArea.y, frame.cols - _activeArea.br().x,
+                                 _activeArea.height)));
+}
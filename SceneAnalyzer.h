@@ -0,0 +1,56 @@
+#ifndef MOVIE_QUALITY_INCREASE_SCENEANALYZER_H
+#define MOVIE_QUALITY_INCREASE_SCENEANALYZER_H
+
+#include <opencv2/core.hpp>
+
+class SceneAnalyzer
+{
+public:
+    /**
+     * @brief Construct a new SceneAnalyzer object
+     */
+    SceneAnalyzer() = default;
+
+    /**
+     * @brief Destroy the SceneAnalyzer object
+     */
+    ~SceneAnalyzer() = default;
+
+    /**
+     * @brief Get the area of the frame that is not covered by letterbox bars
+     * @param frame Current frame, frames must be given in display order
+     * @return Active area of the frame, whole frame if there are no letterbox bars
+     * @note Letterbox bars are detected on the first frame of each scene, then only checked to still be dark
+     */
+    const cv::Rect &getActiveArea(const cv::Mat &frame);
+
+    /**
+     * @brief Get the number of scenes detected so far
+     * @return Number of scenes
+     */
+    [[nodiscard]] size_t getScenesNumber() const;
+
+    /**
+     * @brief Forget previous frames, next frame will be considered as a new scene
+     */
+    void reset();
+
+    static constexpr double LETTERBOX_MAX_LEVEL = 24.0; // Brightest channel value allowed in a letterbox bar
+
+    static constexpr double SCENE_CUT_THRESHOLD = 30.0; // Mean thumbnail difference starting a new scene
+
+private:
+    static cv::Rect DetectActiveArea(const cv::Mat &frame);
+
+    static bool IsDark(const cv::Mat &frameArea);
+
+    [[nodiscard]] bool barsAreStillDark(const cv::Mat &frame) const;
+
+    cv::Mat _previousThumbnail;
+    cv::Rect _activeArea;
+    cv::Size _frameSize;
+    size_t _scenesNumber = 0;
+};
+
+
+#endif //MOVIE_QUALITY_INCREASE_SCENEANALYZER_H
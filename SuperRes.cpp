@@ -1,6 +1,8 @@
 #include <string_view>
 #include <utility>
 #include <stdexcept>
+#include <filesystem>
+#include <cstdlib>
 #include <sys/stat.h>
 #include "SuperRes.h"
 
@@ -35,44 +37,12 @@ void SuperRes::setModelFolderPath(const std::string &modelFolderPath)
 
 void SuperRes::setAlgoAndScale(Algo algo, unsigned short upscaleFactor)
 {
-    if (upscaleFactor < 2 || (upscaleFactor > 4 && algo != Algo::LapSRN) ||
-        (algo == Algo::LapSRN && (upscaleFactor > 8 || upscaleFactor % 2 != 0)))
+    if (!IsScaleSupported(algo, upscaleFactor))
     {
         throw std::invalid_argument("Undefined upscaleFactor");
     }
-    std::string algoStr;
-    switch (algo)
-    {
-        case Algo::EDSR:
-            _inferenceModelPath =
-                    _modelsFolderPath + std::string(EDSR_NAME_AND_SUBPATH.second) + std::to_string(upscaleFactor) +
-                    std::string(MODEl_FILE_EXTENSION);
-            algoStr = std::string(EDSR_NAME_AND_SUBPATH.first);
-            break;
-        case Algo::FSRCNN:
-            _inferenceModelPath =
-                    _modelsFolderPath + std::string(FSRCNN_NAME_AND_SUBPATH.second) + std::to_string(upscaleFactor) +
-                    std::string(MODEl_FILE_EXTENSION);
-            algoStr = std::string(FSRCNN_NAME_AND_SUBPATH.first);
-            break;
-        case Algo::FSRCNN_SMALL:
-            _inferenceModelPath = _modelsFolderPath + std::string(FSRCNN_SMALL_NAME_AND_SUBPATH.second) +
-                                  std::to_string(upscaleFactor) + std::string(MODEl_FILE_EXTENSION);
-            algoStr = std::string(FSRCNN_SMALL_NAME_AND_SUBPATH.first);
-            break;
-        case Algo::LapSRN:
-            _inferenceModelPath =
-                    _modelsFolderPath + std::string(LAPSRN_NAME_AND_SUBPATH.second) + std::to_string(upscaleFactor) +
-                    std::string(MODEl_FILE_EXTENSION);
-            algoStr = std::string(LAPSRN_NAME_AND_SUBPATH.first);
-            break;
-        case Algo::ESPCN:
-            _inferenceModelPath =
-                    _modelsFolderPath + std::string(ESPCN_NAME_AND_SUBPATH.second) + std::to_string(upscaleFactor) +
-                    std::string(MODEl_FILE_EXTENSION);
-            algoStr = std::string(ESPCN_NAME_AND_SUBPATH.first);
-            break;
-    }
+    _inferenceModelPath = GetModelPath(_modelsFolderPath, algo, upscaleFactor);
+    std::string algoStr = std::string(GetNameAndSubpath(algo).first);
     _superresInferenceEngine.readModel(_inferenceModelPath);
     _superresInferenceEngine.setModel(algoStr, upscaleFactor);
     _algo = algo;
@@ -105,6 +75,61 @@ const std::string &SuperRes::getModelsFolderPath() const
     return _modelsFolderPath;
 }
 
+std::string SuperRes::GetModelName(Algo algo, unsigned short upscaleFactor)
+{
+    std::string_view subpath = GetNameAndSubpath(algo).second;
+    return std::string(subpath.substr(subpath.rfind('/') + 1)) + std::to_string(upscaleFactor);
+}
+
+bool SuperRes::IsScaleSupported(Algo algo, unsigned short upscaleFactor)
+{
+    if (algo == Algo::LapSRN)
+    {
+        return upscaleFactor == 2 || upscaleFactor == 4 || upscaleFactor == 8;
+    }
+    return upscaleFactor >= 2 && upscaleFactor <= 4;
+}
+
+std::string SuperRes::GetModelPath(const std::string &modelFolderPath, Algo algo, unsigned short upscaleFactor)
+{
+    return modelFolderPath + std::string(GetNameAndSubpath(algo).second) + std::to_string(upscaleFactor) +
+           std::string(MODEl_FILE_EXTENSION);
+}
+
+bool SuperRes::EnableKernelCache(const std::string &cacheDirectory, bool autoTuning)
+{
+    std::filesystem::create_directories(cacheDirectory);
+    // Read by OpenCV on first DNN or OpenCL use, variables set by the user or a previous call are kept
+    const bool cacheDirectoryUsed = std::getenv("OPENCV_OPENCL_CACHE_DIR") == nullptr &&
+                                    std::getenv("OPENCV_OCL4DNN_CONFIG_PATH") == nullptr;
+    setenv("OPENCV_OPENCL_CACHE_ENABLE", "true", 0); // Compiled OpenCL programs
+    setenv("OPENCV_OPENCL_CACHE_DIR", cacheDirectory.c_str(), 0);
+    setenv("OPENCV_OCL4DNN_CONFIG_PATH", cacheDirectory.c_str(), 0); // Tuned DNN kernels configurations
+    if (autoTuning)
+    {
+        setenv("OPENCV_OCL4DNN_ENABLE_AUTO_TUNING", "1", 0);
+    }
+    return cacheDirectoryUsed;
+}
+
+const std::pair<std::string_view, std::string_view> &SuperRes::GetNameAndSubpath(Algo algo)
+{
+    switch (algo)
+    {
+        case Algo::EDSR:
+            return EDSR_NAME_AND_SUBPATH;
+        case Algo::FSRCNN:
+            return FSRCNN_NAME_AND_SUBPATH;
+        case Algo::FSRCNN_SMALL:
+            return FSRCNN_SMALL_NAME_AND_SUBPATH;
+        case Algo::LapSRN:
+            return LAPSRN_NAME_AND_SUBPATH;
+        case Algo::ESPCN:
+            return ESPCN_NAME_AND_SUBPATH;
+    }
+    throw std::invalid_argument("Unknown algo");
+}
+
 bool SuperRes::PathExists(const std::string &path)
 {
     struct stat info{};
@@ -2,6 +2,9 @@
 #define MOVIE_QUALITY_INCREASE_SUPERRES_H
 
 #include <vector>
+#include <string>
+#include <string_view>
+#include <utility>
 #include <opencv2/dnn_superres.hpp>
 
 class SuperRes
@@ -129,9 +132,47 @@ public:
      */
     [[nodiscard]] unsigned short getScale() const;
 
+    /**
+     * @brief Get the name of a model file, without extension
+     * @param algo The superres algorithm
+     * @param upscaleFactor The upscale factor
+     * @return Model name, for example ESPCN_x2
+     */
+    static std::string GetModelName(Algo algo, unsigned short upscaleFactor);
+
+    /**
+     * @brief Tell whether an algorithm provides a model for an upscale factor
+     * @param algo The superres algorithm
+     * @param upscaleFactor The upscale factor
+     * @return True if the upscale factor is supported by the algorithm
+     */
+    static bool IsScaleSupported(Algo algo, unsigned short upscaleFactor);
+
+    /**
+     * @brief Get the path of a model file
+     * @param modelFolderPath Path to the models folder
+     * @param algo The superres algorithm
+     * @param upscaleFactor The upscale factor
+     * @return Model file path, the file may not exist
+     */
+    static std::string GetModelPath(const std::string &modelFolderPath, Algo algo, unsigned short upscaleFactor);
+
+    /**
+     * @brief Persist compiled OpenCL programs and tuned DNN kernels in a directory
+     * @param cacheDirectory Cache directory, created if needed
+     * @param autoTuning If true, DNN kernels missing from the cache are tuned for the network input shape
+     * @return True if OpenCV will use this directory, false if its cache variables were already set
+     * @note Only sets OpenCV environment variables that are unset. OpenCV reads them once per process, so this must
+     * be called before any OpenCV DNN or OpenCL use, later calls have no effect
+     * @note Auto-tuning makes the first run with an empty cache much slower
+     */
+    static bool EnableKernelCache(const std::string &cacheDirectory, bool autoTuning = false);
+
 private:
     static bool PathExists(const std::string &path);
 
+    static const std::pair<std::string_view, std::string_view> &GetNameAndSubpath(Algo algo);
+
     cv::dnn_superres::DnnSuperResImpl _superresInferenceEngine;
     std::string _inferenceModelPath;
     std::string _modelsFolderPath;
@@ -0,0 +1,389 @@
+#include <stdexcept>
+#include <array>
+#include <cstdlib>
+#include <utility>
+#include <filesystem>
+#include "VideoEncoder.h"
+
+typedef struct
+{
+    VideoEncoder::Codec codec;
+    std::string_view name;
+    std::array<char, 4> fourcc;
+    std::string_view extension; // Default container
+    int apiPreference; // Video backend writing the codec
+    bool rateControl; // Supports FFmpeg preset and crf options
+} CodecDescription;
+
+// FFmpeg refuses writer parameters it doesn't use, quality and stripes are properties of the built-in MJPG encoder
+constexpr std::array<CodecDescription, 6> CODECS_DESCRIPTION = {{
+        {VideoEncoder::Codec::AVC1, "avc1", {'A', 'V', 'C', '1'}, ".mp4", cv::CAP_FFMPEG, true},
+        {VideoEncoder::Codec::HEVC, "hevc", {'h', 'v', 'c', '1'}, ".mp4", cv::CAP_FFMPEG, true},
+        {VideoEncoder::Codec::MP4V, "mp4v", {'m', 'p', '4', 'v'}, ".mp4", cv::CAP_FFMPEG, false},
+        {VideoEncoder::Codec::MJPG, "mjpg", {'M', 'J', 'P', 'G'}, ".avi", cv::CAP_OPENCV_MJPEG, false},
+        {VideoEncoder::Codec::FFV1, "ffv1", {'F', 'F', 'V', '1'}, ".mkv", cv::CAP_FFMPEG, false},
+        {VideoEncoder::Codec::RAW, "raw", {'I', '4', '2', '0'}, ".avi", cv::CAP_FFMPEG, false}
+}};
+
+constexpr std::array<std::pair<VideoEncoder::Preset, std::string_view>, 9> PRESETS_NAME = {{
+        {VideoEncoder::Preset::ULTRAFAST, "ultrafast"},
+        {VideoEncoder::Preset::SUPERFAST, "superfast"},
+        {VideoEncoder::Preset::VERYFAST, "veryfast"},
+        {VideoEncoder::Preset::FASTER, "faster"},
+        {VideoEncoder::Preset::FAST, "fast"},
+        {VideoEncoder::Preset::MEDIUM, "medium"},
+        {VideoEncoder::Preset::SLOW, "slow"},
+        {VideoEncoder::Preset::SLOWER, "slower"},
+        {VideoEncoder::Preset::VERYSLOW, "veryslow"}
+}};
+
+constexpr std::string_view FFMPEG_WRITER_OPTIONS_VARIABLE = "OPENCV_FFMPEG_WRITER_OPTIONS"; // Read on each open
+
+static const CodecDescription &GetCodecDescription(VideoEncoder::Codec codec)
+{
+    for (const CodecDescription &codecDescription: CODECS_DESCRIPTION)
+    {
+        if (codecDescription.codec == codec)
+        {
+            return codecDescription;
+        }
+    }
+    throw std::invalid_argument("Unknown codec");
+}
+
+VideoEncoder::~VideoEncoder()
+{
+    close();
+}
+
+void VideoEncoder::open(const std::string &filename, double fps, const cv::Size &frameSize)
+{
+    close();
+    const CodecDescription &codecDescription = GetCodecDescription(_codec);
+    if (_quality.has_value() && !IsQualitySupported(_codec))
+    {
+        throw std::invalid_argument("Encoder quality is not supported by codec " + std::string(codecDescription.name));
+    }
+    if ((_preset.has_value() || _constantRateFactor.has_value()) && !IsRateControlSupported(_codec))
+    {
+        throw std::invalid_argument(
+                "Encoder preset and crf are not supported by codec " + std::string(codecDescription.name));
+    }
+    const bool builtInEncoder = codecDescription.apiPreference == cv::CAP_OPENCV_MJPEG;
+    const std::string ffmpegOptions = builtInEncoder ? "" : getFfmpegOptions();
+    const char *previousFfmpegOptions = std::getenv(FFMPEG_WRITER_OPTIONS_VARIABLE.data());
+    const std::optional<std::string> savedFfmpegOptions =
+            previousFfmpegOptions == nullptr ? std::nullopt : std::optional<std::string>(previousFfmpegOptions);
+    if (!ffmpegOptions.empty())
+    {
+        setenv(FFMPEG_WRITER_OPTIONS_VARIABLE.data(),
+               (savedFfmpegOptions.has_value() ? savedFfmpegOptions.value() + "|" : "").append(ffmpegOptions).c_str(),
+               1);
+    }
+    auto restoreFfmpegOptions = [&]() {
+        if (ffmpegOptions.empty())
+        {
+            return;
+        }
+        if (savedFfmpegOptions.has_value())
+        {
+            setenv(FFMPEG_WRITER_OPTIONS_VARIABLE.data(), savedFfmpegOptions.value().c_str(), 1);
+        } else
+        {
+            unsetenv(FFMPEG_WRITER_OPTIONS_VARIABLE.data());
+        }
+    };
+    const std::array<char, 4> &fourcc = codecDescription.fourcc;
+    bool opened;
+    try
+    {
+        opened = _videoWriter.open(filename, codecDescription.apiPreference,
+                                   cv::VideoWriter::fourcc(fourcc[0], fourcc[1], fourcc[2], fourcc[3]), fps,
+                                   frameSize);
+    } catch (...)
+    {
+        restoreFfmpegOptions();
+        throw;
+    }
+    restoreFfmpegOptions();
+    if (!opened)
+    {
+        throw std::invalid_argument(
+                "Could not open output video file: " + filename + " with codec " + std::string(codecDescription.name));
+    }
+    if (builtInEncoder) // Properties of the built-in encoder, ignored when given as open parameters
+    {
+        if (_quality.has_value())
+        {
+            _videoWriter.set(cv::VIDEOWRITER_PROP_QUALITY, _quality.value());
+        }
+        if (_encoderThreadsNumber.has_value())
+        {
+            _videoWriter.set(cv::VIDEOWRITER_PROP_NSTRIPES, _encoderThreadsNumber.value());
+        }
+    }
+    _endOfStream = false;
+    _encodedFramesNumber = 0;
+    _encodeDuration = std::chrono::duration<double>(0.0);
+    _encoderThread = std::thread(&VideoEncoder::encodeFramesTask, this);
+}
+
+void VideoEncoder::write(cv::Mat &&frame)
+{
+    if (!_encoderThread.joinable())
+    {
+        throw std::logic_error("Output video is not open");
+    }
+    std::unique_lock<std::mutex> lckWaitingFrames(_mtxWaitingFrames);
+    _conditionVariableQueueOverflow.wait(lckWaitingFrames, [&]() -> bool {
+        return _waitingFrames.size() < _queueCapacity;
+    });
+    _waitingFrames.push(std::move(frame));
+    _conditionVariableQueueEmpty.notify_one();
+}
+
+void VideoEncoder::close()
+{
+    if (!_encoderThread.joinable())
+    {
+        return;
+    }
+    {
+        std::unique_lock<std::mutex> lckWaitingFrames(_mtxWaitingFrames);
+        _endOfStream = true;
+        _conditionVariableQueueEmpty.notify_one();
+    }
+    _encoderThread.join(); // All queued frames are encoded before closing the video writer
+    _videoWriter.release();
+}
+
+VideoEncoder::Codec VideoEncoder::getCodec() const
+{
+    return _codec;
+}
+
+void VideoEncoder::setCodec(Codec codec)
+{
+    _codec = codec;
+}
+
+std::optional<int> VideoEncoder::getQuality() const
+{
+    return _quality;
+}
+
+void VideoEncoder::setQuality(std::optional<int> quality)
+{
+    _quality = quality;
+}
+
+std::optional<int> VideoEncoder::getEncoderThreadsNumber() const
+{
+    return _encoderThreadsNumber;
+}
+
+void VideoEncoder::setEncoderThreadsNumber(std::optional<int> encoderThreadsNumber)
+{
+    _encoderThreadsNumber = encoderThreadsNumber;
+}
+
+std::optional<VideoEncoder::Preset> VideoEncoder::getPreset() const
+{
+    return _preset;
+}
+
+void VideoEncoder::setPreset(std::optional<Preset> preset)
+{
+    _preset = preset;
+}
+
+std::optional<int> VideoEncoder::getConstantRateFactor() const
+{
+    return _constantRateFactor;
+}
+
+void VideoEncoder::setConstantRateFactor(std::optional<int> constantRateFactor)
+{
+    if (constantRateFactor.has_value() &&
+        (constantRateFactor.value() < 0 || constantRateFactor.value() > MAX_CONSTANT_RATE_FACTOR))
+    {
+        throw std::invalid_argument("Constant rate factor must be between 0 and 51");
+    }
+    _constantRateFactor = constantRateFactor;
+}
+
+size_t VideoEncoder::getQueueCapacity() const
+{
+    return _queueCapacity;
+}
+
+void VideoEncoder::setQueueCapacity(size_t queueCapacity)
+{
+    if (queueCapacity == 0)
+    {
+        throw std::invalid_argument("Queue capacity must be at least 1");
+    }
+    _queueCapacity = queueCapacity;
+}
+
+size_t VideoEncoder::getEncodedFramesNumber() const
+{
+    std::unique_lock<std::mutex> lckWaitingFrames(_mtxWaitingFrames);
+    return _encodedFramesNumber;
+}
+
+double VideoEncoder::getEncodeFps() const
+{
+    std::unique_lock<std::mutex> lckWaitingFrames(_mtxWaitingFrames);
+    if (_encodedFramesNumber == 0 || _encodeDuration.count() <= 0.0)
+    {
+        return 0.0;
+    }
+    return (double) _encodedFramesNumber / _encodeDuration.count();
+}
+
+std::optional<VideoEncoder::Codec> VideoEncoder::ParseCodec(std::string_view codecName)
+{
+    for (const CodecDescription &codecDescription: CODECS_DESCRIPTION)
+    {
+        if (codecDescription.name == codecName)
+        {
+            return codecDescription.codec;
+        }
+    }
+    return std::nullopt;
+}
+
+std::string_view VideoEncoder::GetCodecName(Codec codec)
+{
+    return GetCodecDescription(codec).name;
+}
+
+std::string_view VideoEncoder::GetCodecExtension(Codec codec)
+{
+    return GetCodecDescription(codec).extension;
+}
+
+bool VideoEncoder::IsQualitySupported(Codec codec)
+{
+    return GetCodecDescription(codec).apiPreference == cv::CAP_OPENCV_MJPEG;
+}
+
+bool VideoEncoder::IsRateControlSupported(Codec codec)
+{
+    return GetCodecDescription(codec).rateControl;
+}
+
+std::optional<VideoEncoder::Preset> VideoEncoder::ParsePreset(std::string_view presetName)
+{
+    for (const std::pair<Preset, std::string_view> &presetAndName: PRESETS_NAME)
+    {
+        if (presetAndName.second == presetName)
+        {
+            return presetAndName.first;
+        }
+    }
+    return std::nullopt;
+}
+
+std::string_view VideoEncoder::GetPresetName(Preset preset)
+{
+    for (const std::pair<Preset, std::string_view> &presetAndName: PRESETS_NAME)
+    {
+        if (presetAndName.first == preset)
+        {
+            return presetAndName.second;
+        }
+    }
+    throw std::invalid_argument("Unknown preset");
+}
+
+std::vector<VideoEncoder::BenchmarkResult>
+VideoEncoder::Benchmark(const std::vector<cv::Mat> &frames, double fps, const std::string &directory)
+{
+    std::vector<BenchmarkResult> benchmarkResults;
+    if (frames.empty())
+    {
+        return benchmarkResults;
+    }
+    for (const CodecDescription &codecDescription: CODECS_DESCRIPTION)
+    {
+        BenchmarkResult benchmarkResult{.codec = codecDescription.codec, .available = false, .framesPerSecond = 0.0,
+                                        .bytesPerFrame = 0};
+        std::filesystem::path videoPath = std::filesystem::path(directory) /
+                                          ("encoder_benchmark_" + std::string(codecDescription.name) +
+                                           std::string(codecDescription.extension));
+        VideoEncoder videoEncoder;
+        videoEncoder.setCodec(codecDescription.codec);
+        try
+        {
+            videoEncoder.open(videoPath.string(), fps, frames.front().size());
+            benchmarkResult.available = true;
+        } catch (const std::invalid_argument &) // Codec not built in the video backend
+        {
+        }
+        if (benchmarkResult.available)
+        {
+            for (const cv::Mat &frame: frames)
+            {
+                videoEncoder.write(frame.clone()); // Copy is not accounted in encode time
+            }
+            videoEncoder.close();
+            benchmarkResult.framesPerSecond = videoEncoder.getEncodeFps();
+            benchmarkResult.bytesPerFrame = std::filesystem::file_size(videoPath) / frames.size();
+        }
+        std::error_code errorCode; // Ignore removal errors
+        std::filesystem::remove(videoPath, errorCode);
+        benchmarkResults.push_back(benchmarkResult);
+    }
+    return benchmarkResults;
+}
+
+void VideoEncoder::encodeFramesTask()
+{
+    while (true)
+    {
+        cv::Mat frame;
+        {
+            std::unique_lock<std::mutex> lckWaitingFrames(_mtxWaitingFrames);
+            _conditionVariableQueueEmpty.wait(lckWaitingFrames, [&]() -> bool {
+                return !_waitingFrames.empty() || _endOfStream;
+            });
+            if (_waitingFrames.empty()) // End of stream and every frame is encoded
+            {
+                return;
+            }
+            frame = std::move(_waitingFrames.front());
+            _waitingFrames.pop();
+            _conditionVariableQueueOverflow.notify_one();
+        }
+        auto encodeBeginTime = std::chrono::steady_clock::now();
+        _videoWriter.write(frame);
+        std::chrono::duration<double> frameEncodeDuration = std::chrono::steady_clock::now() - encodeBeginTime;
+        std::unique_lock<std::mutex> lckWaitingFrames(_mtxWaitingFrames);
+        _encodeDuration += frameEncodeDuration;
+        ++_encodedFramesNumber;
+    }
+}
+
+std::string VideoEncoder::getFfmpegOptions() const
+{
+    // AVDictionary syntax parsed by OpenCV: key;value pairs separated by |
+    std::string ffmpegOptions;
+    auto addOption = [&](std::string_view key, std::string_view value) {
+        ffmpegOptions.append(ffmpegOptions.empty() ? "" : "|").append(key).append(";").append(value);
+    };
+    if (_encoderThreadsNumber.has_value())
+    {
+        addOption("threads", std::to_string(_encoderThreadsNumber.value()));
+    }
+    if (_preset.has_value())
+    {
+        addOption("preset", GetPresetName(_preset.value()));
+    }
+    if (_constantRateFactor.has_value())
+    {
+        addOption("crf", std::to_string(_constantRateFactor.value()));
+    }
+    return ffmpegOptions;
+}
@@ -0,0 +1,305 @@
+#ifndef MOVIE_QUALITY_INCREASE_VIDEOENCODER_H
+#define MOVIE_QUALITY_INCREASE_VIDEOENCODER_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <queue>
+#include <optional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <opencv2/videoio.hpp>
+
+class VideoEncoder
+{
+public:
+    enum class Codec
+    {
+        /**
+         * @brief H.264, small files but slow encoding
+         * @note Container: .mp4
+         */
+        AVC1,
+
+        /**
+         * @brief H.265, smaller files than H.264 but even slower encoding
+         * @note Container: .mp4
+         */
+        HEVC,
+
+        /**
+         * @brief MPEG-4 part 2, faster encoding than H.264 with bigger files
+         * @note Container: .mp4
+         */
+        MP4V,
+
+        /**
+         * @brief Motion JPEG, intra-only and fast, good intermediate when a re-encode follows
+         * @note Container: .avi
+         * @note Written by the OpenCV built-in encoder, the only codec supporting quality
+         */
+        MJPG,
+
+        /**
+         * @brief FFV1, lossless intra-only intermediate
+         * @note Container: .mkv
+         */
+        FFV1,
+
+        /**
+         * @brief Uncompressed YUV 4:2:0, fastest encoding but huge files
+         * @note Container: .avi
+         */
+        RAW
+    };
+
+    /**
+     * @brief Speed preset of the H.264 and H.265 encoders, faster presets give bigger files at the same quality
+     */
+    enum class Preset
+    {
+        ULTRAFAST,
+        SUPERFAST,
+        VERYFAST,
+        FASTER,
+        FAST,
+        MEDIUM,
+        SLOW,
+        SLOWER,
+        VERYSLOW
+    };
+
+    typedef struct
+    {
+        Codec codec;
+        bool available; // False if the codec couldn't be opened by the video backend
+        double framesPerSecond; // Encoding throughput
+        unsigned long long bytesPerFrame; // Mean encoded frame size
+    } BenchmarkResult;
+
+    /**
+     * @brief Construct a new VideoEncoder object
+     * @note Default codec is AVC1, call open() before writing frames
+     */
+    VideoEncoder() = default;
+
+    VideoEncoder(const VideoEncoder &other) = delete; // Disallow copy
+
+    VideoEncoder &operator=(const VideoEncoder &other) = delete; // Disallow copy
+
+    /**
+     * @brief Destroy the VideoEncoder object, waiting for queued frames to be encoded
+     */
+    ~VideoEncoder();
+
+    /**
+     * @brief Open the output video and start the encoder thread
+     * @param filename Output video filename, its extension selects the container
+     * @param fps Frames per second
+     * @param frameSize Size of the frames that will be written
+     * @throw std::invalid_argument If the output video could not be opened with the selected codec, or if an option
+     * set on the encoder is not supported by the codec
+     * @note If a video was already open, it is closed first
+     * @note FFmpeg encoder options are given through the OPENCV_FFMPEG_WRITER_OPTIONS environment variable, appended
+     * to its current value and restored once the video is open, so videos must not be opened concurrently
+     */
+    void open(const std::string &filename, double fps, const cv::Size &frameSize);
+
+    /**
+     * @brief Queue a frame for encoding
+     * @param frame Frame to encode, ownership is transferred to the encoder thread
+     * @throw std::logic_error If the output video is not open
+     * @note Blocks while the queue is full
+     */
+    void write(cv::Mat &&frame);
+
+    /**
+     * @brief Wait for queued frames to be encoded, then close the output video
+     * @note Does nothing if the output video is not open
+     */
+    void close();
+
+    /**
+     * @brief Get the codec
+     * @return Codec used for next opened video
+     */
+    [[nodiscard]] Codec getCodec() const;
+
+    /**
+     * @brief Set the codec
+     * @param codec Codec used for next opened video
+     * @note Output video extension must match a container supporting the codec
+     */
+    void setCodec(Codec codec);
+
+    /**
+     * @brief Get the encoder quality
+     * @return Quality (0 - 100), std::nullopt for the backend default
+     */
+    [[nodiscard]] std::optional<int> getQuality() const;
+
+    /**
+     * @brief Set the encoder quality
+     * @param quality Quality (0 - 100), std::nullopt for the backend default
+     * @note Only supported by MJPG, see IsQualitySupported(), use the constant rate factor with H.264 and H.265
+     */
+    void setQuality(std::optional<int> quality);
+
+    /**
+     * @brief Get the number of threads used by the encoder
+     * @return Number of threads, std::nullopt for the backend default
+     */
+    [[nodiscard]] std::optional<int> getEncoderThreadsNumber() const;
+
+    /**
+     * @brief Set the number of threads used by the encoder, in addition to the thread feeding it
+     * @param encoderThreadsNumber Number of threads, std::nullopt for the backend default
+     * @note Useful to keep encoding from competing with inference instances
+     * @note FFmpeg codecs get it as their threads option, MJPG encodes this number of stripes in parallel
+     */
+    void setEncoderThreadsNumber(std::optional<int> encoderThreadsNumber);
+
+    /**
+     * @brief Get the encoder speed preset
+     * @return Preset, std::nullopt for the encoder default
+     */
+    [[nodiscard]] std::optional<Preset> getPreset() const;
+
+    /**
+     * @brief Set the encoder speed preset
+     * @param preset Preset, std::nullopt for the encoder default
+     * @note Only supported by H.264 and H.265, see IsRateControlSupported()
+     */
+    void setPreset(std::optional<Preset> preset);
+
+    /**
+     * @brief Get the encoder constant rate factor
+     * @return Constant rate factor, std::nullopt for the encoder default
+     */
+    [[nodiscard]] std::optional<int> getConstantRateFactor() const;
+
+    /**
+     * @brief Set the encoder constant rate factor
+     * @param constantRateFactor Constant rate factor (0 - 51), lower is better quality, std::nullopt for the
+     * encoder default
+     * @throw std::invalid_argument If constant rate factor is out of range
+     * @note Only supported by H.264 and H.265, see IsRateControlSupported()
+     */
+    void setConstantRateFactor(std::optional<int> constantRateFactor);
+
+    /**
+     * @brief Get the maximum number of frames waiting for encoding
+     * @return Queue capacity
+     */
+    [[nodiscard]] size_t getQueueCapacity() const;
+
+    /**
+     * @brief Set the maximum number of frames waiting for encoding
+     * @param queueCapacity Queue capacity, at least 1
+     * @throw std::invalid_argument If queue capacity is 0
+     */
+    void setQueueCapacity(size_t queueCapacity);
+
+    /**
+     * @brief Get the number of frames encoded since the output video was opened
+     * @return Number of encoded frames
+     */
+    [[nodiscard]] size_t getEncodedFramesNumber() const;
+
+    /**
+     * @brief Get the encoding throughput since the output video was opened
+     * @return Encoded frames per second of encoding time, 0 if no frame has been encoded
+     */
+    [[nodiscard]] double getEncodeFps() const;
+
+    /**
+     * @brief Get the codec corresponding to a name
+     * @param codecName Codec name: avc1, hevc, mp4v, mjpg, ffv1 or raw
+     * @return Codec, std::nullopt if the name is unknown
+     */
+    static std::optional<Codec> ParseCodec(std::string_view codecName);
+
+    /**
+     * @brief Get the name of a codec
+     * @param codec Codec
+     * @return Codec name, as accepted by ParseCodec()
+     */
+    static std::string_view GetCodecName(Codec codec);
+
+    /**
+     * @brief Get the default container extension of a codec
+     * @param codec Codec
+     * @return Extension, with the leading dot
+     */
+    static std::string_view GetCodecExtension(Codec codec);
+
+    /**
+     * @brief Tell whether a codec supports quality, see setQuality()
+     * @param codec Codec
+     * @return True if supported
+     */
+    static bool IsQualitySupported(Codec codec);
+
+    /**
+     * @brief Tell whether a codec supports preset and constant rate factor, see setPreset() and setConstantRateFactor()
+     * @param codec Codec
+     * @return True if supported
+     */
+    static bool IsRateControlSupported(Codec codec);
+
+    /**
+     * @brief Get the preset corresponding to a name
+     * @param presetName Preset name, as given to x264: ultrafast, superfast, veryfast, faster, fast, medium, slow,
+     * slower or veryslow
+     * @return Preset, std::nullopt if the name is unknown
+     */
+    static std::optional<Preset> ParsePreset(std::string_view presetName);
+
+    /**
+     * @brief Get the name of a preset
+     * @param preset Preset
+     * @return Preset name, as accepted by ParsePreset()
+     */
+    static std::string_view GetPresetName(Preset preset);
+
+    /**
+     * @brief Measure the encoding throughput of every codec
+     * @param frames Frames to encode, all of the same size
+     * @param fps Frames per second of the encoded videos
+     * @param directory Directory where temporary videos are written, they are removed afterwards
+     * @return Encoding throughput and mean encoded frame size for each codec
+     */
+    static std::vector<BenchmarkResult>
+    Benchmark(const std::vector<cv::Mat> &frames, double fps, const std::string &directory);
+
+    static constexpr Codec DEFAULT_CODEC = Codec::AVC1;
+
+    static constexpr size_t DEFAULT_QUEUE_CAPACITY = 8;
+
+    static constexpr int MAX_CONSTANT_RATE_FACTOR = 51;
+
+private:
+    void encodeFramesTask();
+
+    [[nodiscard]] std::string getFfmpegOptions() const;
+
+    cv::VideoWriter _videoWriter;
+    Codec _codec = DEFAULT_CODEC;
+    std::optional<int> _quality;
+    std::optional<int> _encoderThreadsNumber;
+    std::optional<Preset> _preset;
+    std::optional<int> _constantRateFactor;
+    size_t _queueCapacity = DEFAULT_QUEUE_CAPACITY;
+    std::thread _encoderThread;
+    std::queue<cv::Mat> _waitingFrames; // Frames waiting to be encoded
+    bool _endOfStream = false; // No more frames will be queued
+    mutable std::mutex _mtxWaitingFrames;
+    std::condition_variable _conditionVariableQueueOverflow, _conditionVariableQueueEmpty;
+    size_t _encodedFramesNumber = 0;
+    std::chrono::duration<double> _encodeDuration{0.0}; // Time spent in the encoder
+};
+
+
+#endif //MOVIE_QUALITY_INCREASE_VIDEOENCODER_H
@@ -17,12 +17,80 @@ int main(int argc, char *argv[])
     {
         movieUpscaler.setSuperresInstancesNumber(config.getSimultaneousInstances());
     }
+    movieUpscaler.setHybridDetailThreshold(config.getHybridDetailThreshold());
+    movieUpscaler.setCascadePreference(config.getCascadePreference());
+    movieUpscaler.setWarmUp(config.getWarmUp());
+    movieUpscaler.setKernelCacheDirectory(config.getKernelCacheDirectory());
+    movieUpscaler.setKernelAutoTuning(config.getKernelAutoTuning());
+    movieUpscaler.getVideoEncoder().setCodec(config.getCodec());
+    movieUpscaler.getVideoEncoder().setQuality(config.getEncoderQuality());
+    movieUpscaler.getVideoEncoder().setEncoderThreadsNumber(config.getEncoderThreadsNumber());
+    movieUpscaler.getVideoEncoder().setPreset(config.getEncoderPreset());
+    movieUpscaler.getVideoEncoder().setConstantRateFactor(config.getConstantRateFactor());
+    auto progressCallback = [](size_t frameID) -> bool {
+        std::cout << "\rFrame: " << frameID << std::flush;
+        return true; // Continue until the end of the movie
+    };
     try
     {
-        movieUpscaler.run([](size_t frameID) -> bool {
-            std::cout << "\rFrame: " << frameID << std::flush;
-            return true; // Continue until the end of the movie
-        });
+        movieUpscaler.setFrameRange(config.getStartFrame(), config.getEndFrame());
+        if (config.getEncoderBenchmarkFramesNumber() > 0) // Only measure encoders throughput
+        {
+            for (const VideoEncoder::BenchmarkResult &benchmarkResult: movieUpscaler.benchmarkEncoders(
+                    config.getEncoderBenchmarkFramesNumber()))
+            {
+                std::cout << VideoEncoder::GetCodecName(benchmarkResult.codec) << ": ";
+                if (benchmarkResult.available)
+                {
+                    std::cout << benchmarkResult.framesPerSecond << " fps, "
+                              << (double) benchmarkResult.bytesPerFrame / 1024.0 << " KiB/frame" << std::endl;
+                } else
+                {
+                    std::cout << "unavailable" << std::endl;
+                }
+            }
+            return 0;
+        }
+        if (config.getPreviewClipsNumber() > 0) // Only estimate the full run
+        {
+            MovieUpscaler::PreviewEstimation estimation = movieUpscaler.preview(
+                    config.getPreviewClipsNumber(), MovieUpscaler::DEFAULT_PREVIEW_CLIP_FRAMES_NUMBER,
+                    progressCallback);
+            std::cout << std::endl << "Preview frames: " << estimation.previewFramesNumber << std::endl;
+            std::cout << "Throughput: " << estimation.framesPerSecond << " fps" << std::endl;
+            std::cout << "Projected full run: " << estimation.projectedFramesNumber << " frames, "
+                      << estimation.projectedDurationSeconds / 3600.0 << " hours, "
+                      << (double) estimation.projectedOutputSize / (1024.0 * 1024.0) << " MiB" << std::endl;
+            return 0;
+        }
+        movieUpscaler.run(progressCallback);
+        std::cout << std::endl;
+        if (movieUpscaler.getCascadePlan().has_value())
+        {
+            const CascadePlanner::Plan &cascadePlan = movieUpscaler.getCascadePlan().value();
+            std::cout << "Models chain: " << CascadePlanner::GetPlanDescription(cascadePlan);
+            if (cascadePlan.cost > 0.0) // Else chosen without timing
+            {
+                std::cout << ", estimated " << cascadePlan.cost * 1e9 << " ms per input megapixel";
+            }
+            std::cout << std::endl;
+        }
+        if (config.getWarmUp())
+        {
+            std::cout << "Warm up: " << movieUpscaler.getWarmUpDuration() << " s" << std::endl;
+        }
+        if (movieUpscaler.getTimeToFirstFrame().has_value())
+        {
+            std::cout << "Time to first frame: " << movieUpscaler.getTimeToFirstFrame().value() << " s" << std::endl;
+        }
+        std::cout << "Encoding: " << movieUpscaler.getVideoEncoder().getEncodeFps() << " fps ("
+                  << VideoEncoder::GetCodecName(config.getCodec()) << ")" << std::endl;
+        if (config.getHybridDetailThreshold().has_value())
+        {
+            std::cout << "Neural network workload: " << movieUpscaler.getDnnPixelsFraction() * 100.0
+                      << "% of active area pixels, tiles margins add " << movieUpscaler.getDnnMarginsOverhead() * 100.0
+                      << "%" << std::endl;
+        }
     } catch (std::exception const &e)
     {
         std::cerr << "Error: " << e.what() << std::endl;
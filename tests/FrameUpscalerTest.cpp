@@ -0,0 +1,247 @@
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <map>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <opencv2/imgproc.hpp>
+#include "FrameUpscaler.h"
+#include "CascadePlanner.h"
+#include "TestUtils.h"
+
+// Frame ordering and end of stream handling of FrameUpscaler, with markers embedded in synthetic frames
+
+constexpr int FRAME_WIDTH = 320;
+constexpr int FRAME_HEIGHT = 180;
+constexpr size_t FRAMES_NUMBER = 40; // Several times the instances and output queue capacity
+constexpr size_t INSTANCES_NUMBER = 4;
+
+static void CheckFramesOrder(const std::vector<FrameUpscaler::UpscaledFrame> &upscaledFrames, size_t firstIndex,
+                             size_t framesNumber, const cv::Size &outputSize)
+{
+    const cv::Size inputSize(FRAME_WIDTH, FRAME_HEIGHT);
+    TestUtils::Check(upscaledFrames.size() == framesNumber,
+                     "Expected " + std::to_string(framesNumber) + " frames, got " +
+                     std::to_string(upscaledFrames.size()));
+    for (size_t i = 0; i < upscaledFrames.size(); ++i)
+    {
+        const size_t expectedIndex = firstIndex + i;
+        TestUtils::Check(upscaledFrames[i].timestamp == (int64_t) expectedIndex,
+                         "Frame " + std::to_string(expectedIndex) + " has timestamp " +
+                         std::to_string(upscaledFrames[i].timestamp));
+        TestUtils::Check(upscaledFrames[i].frame.size() == outputSize,
+                         "Frame " + std::to_string(expectedIndex) + " has wrong size");
+        size_t marker = TestUtils::ReadFrameMarker(upscaledFrames[i].frame, inputSize);
+        TestUtils::Check(marker == expectedIndex,
+                         "Frame " + std::to_string(expectedIndex) + " carries marker " + std::to_string(marker));
+    }
+}
+
+static void SetCallbackCollector(FrameUpscaler &frameUpscaler, std::vector<FrameUpscaler::UpscaledFrame> &collected)
+{
+    // Called from a single internal thread, finish() returns after the last call
+    frameUpscaler.setOutputCallback([&collected](FrameUpscaler::UpscaledFrame &&upscaledFrame) {
+        collected.push_back(std::move(upscaledFrame));
+    });
+}
+
+static cv::Mat CreateUnevenFrame(size_t frameIndex)
+{
+    // In hybrid mode, a flat frame only sends its marker tiles to the network: it overtakes the detailed frame pushed
+    // just before it, so that frames complete out of order
+    const cv::Size frameSize(FRAME_WIDTH, FRAME_HEIGHT);
+    return frameIndex % 2 == 0 ? TestUtils::CreateSyntheticFrame(frameSize, frameIndex) :
+           TestUtils::CreateFlatFrame(frameSize, frameIndex);
+}
+
+static void TestPullOrder(const std::string &modelsPath)
+{
+    FrameUpscaler frameUpscaler(modelsPath, 2, INSTANCES_NUMBER);
+    frameUpscaler.setHybridDetailThreshold(HybridUpscaler::DEFAULT_DETAIL_THRESHOLD);
+    std::vector<FrameUpscaler::UpscaledFrame> pulledFrames;
+    std::thread pullThread([&]() {
+        while (std::optional<FrameUpscaler::UpscaledFrame> upscaledFrame = frameUpscaler.pull())
+        {
+            pulledFrames.push_back(std::move(upscaledFrame.value()));
+        }
+    });
+    for (size_t i = 0; i < FRAMES_NUMBER; ++i)
+    {
+        frameUpscaler.push(CreateUnevenFrame(i), (int64_t) i);
+    }
+    frameUpscaler.finish();
+    pullThread.join(); // pull() must return std::nullopt once the stream is over
+    CheckFramesOrder(pulledFrames, 0, FRAMES_NUMBER, cv::Size(FRAME_WIDTH * 2, FRAME_HEIGHT * 2));
+}
+
+static void TestCallbackOrder(const std::string &modelsPath)
+{
+    FrameUpscaler frameUpscaler(modelsPath, 3, INSTANCES_NUMBER);
+    frameUpscaler.setHybridDetailThreshold(HybridUpscaler::DEFAULT_DETAIL_THRESHOLD);
+    std::vector<FrameUpscaler::UpscaledFrame> collectedFrames;
+    SetCallbackCollector(frameUpscaler, collectedFrames);
+    for (size_t i = 0; i < FRAMES_NUMBER; ++i)
+    {
+        frameUpscaler.push(CreateUnevenFrame(i), (int64_t) i);
+    }
+    frameUpscaler.finish();
+    CheckFramesOrder(collectedFrames, 0, FRAMES_NUMBER, cv::Size(FRAME_WIDTH * 3, FRAME_HEIGHT * 3));
+}
+
+static void TestRawBuffers(const std::string &modelsPath)
+{
+    std::vector<cv::Mat> buffers; // Owned by the test, as a caller with its own frame pool would do
+    for (size_t i = 0; i < FRAMES_NUMBER; ++i)
+    {
+        buffers.push_back(TestUtils::CreateSyntheticFrame(cv::Size(FRAME_WIDTH, FRAME_HEIGHT), i));
+    }
+    std::atomic<size_t> releasedBuffersNumber{0};
+    std::vector<FrameUpscaler::UpscaledFrame> collectedFrames;
+    {
+        FrameUpscaler frameUpscaler(modelsPath, 2, INSTANCES_NUMBER);
+        SetCallbackCollector(frameUpscaler, collectedFrames);
+        for (size_t i = 0; i < FRAMES_NUMBER; ++i)
+        {
+            frameUpscaler.push(buffers[i].data, buffers[i].cols, buffers[i].rows, buffers[i].type(), buffers[i].step,
+                               (int64_t) i, [&releasedBuffersNumber]() {
+                        ++releasedBuffersNumber;
+                    });
+        }
+        frameUpscaler.finish();
+    }
+    TestUtils::Check(releasedBuffersNumber == FRAMES_NUMBER,
+                     std::to_string(releasedBuffersNumber) + " buffers released out of " +
+                     std::to_string(FRAMES_NUMBER));
+    CheckFramesOrder(collectedFrames, 0, FRAMES_NUMBER, cv::Size(FRAME_WIDTH * 2, FRAME_HEIGHT * 2));
+}
+
+static void TestStreamRestart(const std::string &modelsPath)
+{
+    FrameUpscaler frameUpscaler(modelsPath, 2, INSTANCES_NUMBER);
+    for (size_t stream = 0; stream < 2; ++stream)
+    {
+        const size_t firstIndex = stream * 100;
+        std::vector<FrameUpscaler::UpscaledFrame> collectedFrames;
+        SetCallbackCollector(frameUpscaler, collectedFrames);
+        for (size_t i = firstIndex; i < firstIndex + FRAMES_NUMBER / 2; ++i)
+        {
+            frameUpscaler.push(TestUtils::CreateSyntheticFrame(cv::Size(FRAME_WIDTH, FRAME_HEIGHT), i), (int64_t) i);
+        }
+        frameUpscaler.finish();
+        CheckFramesOrder(collectedFrames, firstIndex, FRAMES_NUMBER / 2, cv::Size(FRAME_WIDTH * 2, FRAME_HEIGHT * 2));
+    }
+}
+
+static void TestPullStreamRestart(const std::string &modelsPath)
+{
+    // Single threaded caller starting the next stream before pulling the previous one, must not deadlock
+    constexpr size_t STREAM_FRAMES_NUMBER = 3; // Two streams fit in the output queue and the instances
+    FrameUpscaler frameUpscaler(modelsPath, 2, INSTANCES_NUMBER);
+    for (size_t stream = 0; stream < 2; ++stream)
+    {
+        for (size_t i = stream * 100; i < stream * 100 + STREAM_FRAMES_NUMBER; ++i)
+        {
+            frameUpscaler.push(TestUtils::CreateSyntheticFrame(cv::Size(FRAME_WIDTH, FRAME_HEIGHT), i), (int64_t) i);
+        }
+        frameUpscaler.finish();
+    }
+    for (size_t stream = 0; stream < 2; ++stream)
+    {
+        std::vector<FrameUpscaler::UpscaledFrame> pulledFrames;
+        while (std::optional<FrameUpscaler::UpscaledFrame> upscaledFrame = frameUpscaler.pull())
+        {
+            pulledFrames.push_back(std::move(upscaledFrame.value()));
+        }
+        CheckFramesOrder(pulledFrames, stream * 100, STREAM_FRAMES_NUMBER, cv::Size(FRAME_WIDTH * 2, FRAME_HEIGHT * 2));
+    }
+}
+
+static void TestYuvPlanes(const std::string &modelsPath)
+{
+    constexpr int CHROMA_ROW_PADDING = 16;
+    std::vector<FrameUpscaler::UpscaledFrame> collectedFrames;
+    FrameUpscaler frameUpscaler(modelsPath, 2, INSTANCES_NUMBER);
+    SetCallbackCollector(frameUpscaler, collectedFrames);
+    for (size_t i = 0; i < FRAMES_NUMBER; ++i)
+    {
+        cv::Mat i420Frame; // Y, then U, then V
+        cv::cvtColor(TestUtils::CreateSyntheticFrame(cv::Size(FRAME_WIDTH, FRAME_HEIGHT), i), i420Frame,
+                     cv::COLOR_BGR2YUV_I420);
+        const cv::Mat yPlane = i420Frame.rowRange(0, FRAME_HEIGHT);
+        uchar *uSource = i420Frame.ptr(FRAME_HEIGHT);
+        uchar *vSource = uSource + FRAME_WIDTH / 2 * FRAME_HEIGHT / 2;
+        cv::Mat uPlane, vPlane; // Rows padded, as decoders often align them
+        cv::copyMakeBorder(cv::Mat(FRAME_HEIGHT / 2, FRAME_WIDTH / 2, CV_8UC1, uSource), uPlane, 0, 0, 0,
+                           CHROMA_ROW_PADDING, cv::BORDER_CONSTANT);
+        cv::copyMakeBorder(cv::Mat(FRAME_HEIGHT / 2, FRAME_WIDTH / 2, CV_8UC1, vSource), vPlane, 0, 0, 0,
+                           CHROMA_ROW_PADDING, cv::BORDER_CONSTANT);
+        if (i % 2 == 0)
+        {
+            frameUpscaler.push(FrameUpscaler::YuvFormat::I420, {yPlane.data, uPlane.data, vPlane.data},
+                               {yPlane.step, uPlane.step, vPlane.step}, FRAME_WIDTH, FRAME_HEIGHT, (int64_t) i);
+            continue;
+        }
+        std::vector<cv::Mat> uvChannels = {uPlane.colRange(0, FRAME_WIDTH / 2), vPlane.colRange(0, FRAME_WIDTH / 2)};
+        cv::Mat uvPlane;
+        cv::merge(uvChannels, uvPlane);
+        frameUpscaler.push(FrameUpscaler::YuvFormat::NV12, {yPlane.data, uvPlane.data}, {yPlane.step, uvPlane.step},
+                           FRAME_WIDTH, FRAME_HEIGHT, (int64_t) i);
+    }
+    frameUpscaler.finish();
+    CheckFramesOrder(collectedFrames, 0, FRAMES_NUMBER, cv::Size(FRAME_WIDTH * 2, FRAME_HEIGHT * 2));
+}
+
+static void TestCascadeOrder(const std::string &modelsPath)
+{
+    CascadePlanner cascadePlanner(modelsPath);
+    for (const CascadePlanner::Stage &model: cascadePlanner.getAvailableModels())
+    {
+        cascadePlanner.setModelTiming(model, 1e-8); // Plan doesn't matter here, only skip the timing of every model
+    }
+    const CascadePlanner::Plan cascadePlan = cascadePlanner.plan(2.5, CascadePlanner::Preference::SPEED);
+    FrameUpscaler frameUpscaler(modelsPath, cascadePlan, INSTANCES_NUMBER);
+    std::vector<FrameUpscaler::UpscaledFrame> collectedFrames;
+    SetCallbackCollector(frameUpscaler, collectedFrames);
+    for (size_t i = 0; i < FRAMES_NUMBER; ++i)
+    {
+        frameUpscaler.push(TestUtils::CreateSyntheticFrame(cv::Size(FRAME_WIDTH, FRAME_HEIGHT), i), (int64_t) i);
+    }
+    frameUpscaler.finish();
+    CheckFramesOrder(collectedFrames, 0, FRAMES_NUMBER,
+                     frameUpscaler.getOutputSize(cv::Size(FRAME_WIDTH, FRAME_HEIGHT)));
+}
+
+static void TestDestroyWithoutPull(const std::string &modelsPath)
+{
+    // Output queue fills up and nobody pulls: destruction must neither hang nor crash
+    FrameUpscaler frameUpscaler(modelsPath, 2, INSTANCES_NUMBER);
+    for (size_t i = 0; i < INSTANCES_NUMBER + FrameUpscaler::DEFAULT_OUTPUT_QUEUE_CAPACITY; ++i)
+    {
+        frameUpscaler.push(TestUtils::CreateSyntheticFrame(cv::Size(FRAME_WIDTH, FRAME_HEIGHT), i), (int64_t) i);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    const std::map<std::string_view, std::function<void(const std::string &)>> tests = {
+            {"pull-order",           TestPullOrder},
+            {"callback-order",       TestCallbackOrder},
+            {"raw-buffers",          TestRawBuffers},
+            {"stream-restart",       TestStreamRestart},
+            {"pull-stream-restart",  TestPullStreamRestart},
+            {"yuv-planes",           TestYuvPlanes},
+            {"cascade-order",        TestCascadeOrder},
+            {"destroy-without-pull", TestDestroyWithoutPull}
+    };
+    if (argc != 3 || tests.count(argv[2]) == 0)
+    {
+        std::cerr << "Usage: " << argv[0] << " <modelsDirectoryPath> <testName>" << std::endl;
+        return 2;
+    }
+    const std::string modelsPath = argv[1];
+    return TestUtils::RunTest(argv[2], [&]() {
+        tests.at(argv[2])(modelsPath);
+    });
+}
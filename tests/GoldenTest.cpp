@@ -0,0 +1,86 @@
+#include <iostream>
+#include <string>
+#include <cstdlib>
+#include <filesystem>
+#include <opencv2/imgproc.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include "SuperRes.h"
+#include "CascadePlanner.h"
+#include "TestUtils.h"
+
+// Output of every bundled model and scale on the golden input, compared to golden outputs
+// Set MOVIE_QUALITY_INCREASE_UPDATE_GOLDEN=1 to write the golden input and outputs instead, then check and commit them
+// Skipped while no golden output has been recorded
+
+constexpr int FRAME_WIDTH = 320;
+constexpr int FRAME_HEIGHT = 180;
+constexpr size_t FRAME_INDEX = 1234;
+const cv::Rect GOLDEN_INPUT_RECT(176, 56, 96, 64); // Edges and grain, small enough to keep golden files light
+constexpr double MIN_GOLDEN_PSNR = 50.0; // dB, inference targets only differ by rounding, bicubic is around 40 dB
+constexpr double MIN_BICUBIC_PSNR = 20.0; // dB, catches garbage before comparing to golden outputs
+constexpr std::string_view GOLDEN_INPUT_FILENAME = "input.png";
+constexpr std::string_view UPDATE_GOLDEN_VARIABLE = "MOVIE_QUALITY_INCREASE_UPDATE_GOLDEN";
+
+int main(int argc, char *argv[])
+{
+    if (argc != 3)
+    {
+        std::cerr << "Usage: " << argv[0] << " <modelsDirectoryPath> <goldenDirectoryPath>" << std::endl;
+        return 2;
+    }
+    const std::string modelsPath = argv[1];
+    const std::filesystem::path goldenDirectory = argv[2];
+    const bool updateGolden = std::getenv(UPDATE_GOLDEN_VARIABLE.data()) != nullptr;
+    // Input is stored with the outputs, so that outputs don't depend on how synthetic frames are drawn
+    const std::filesystem::path inputPath = goldenDirectory / GOLDEN_INPUT_FILENAME;
+    if (!updateGolden && !std::filesystem::exists(inputPath))
+    {
+        std::cout << "No golden outputs in " << goldenDirectory.string() << ", run with " << UPDATE_GOLDEN_VARIABLE
+                  << "=1 to record them from this build, then check and commit them" << std::endl;
+        return TestUtils::SKIP_RETURN_CODE;
+    }
+    return TestUtils::RunTest("golden", [&]() {
+        cv::Mat input;
+        if (updateGolden)
+        {
+            input = TestUtils::CreateSyntheticFrame(cv::Size(FRAME_WIDTH, FRAME_HEIGHT), FRAME_INDEX)(
+                    GOLDEN_INPUT_RECT).clone();
+            std::filesystem::create_directories(goldenDirectory);
+            TestUtils::Check(cv::imwrite(inputPath.string(), input), "Could not write " + inputPath.string());
+        } else
+        {
+            input = cv::imread(inputPath.string(), cv::IMREAD_COLOR);
+            TestUtils::Check(!input.empty(), "Could not read " + inputPath.string());
+        }
+        CascadePlanner cascadePlanner(modelsPath); // Only used to list the bundled models
+        TestUtils::Check(!cascadePlanner.getAvailableModels().empty(), "No model found in " + modelsPath);
+        for (const CascadePlanner::Stage &model: cascadePlanner.getAvailableModels())
+        {
+            const std::string modelName = SuperRes::GetModelName(model.algo, model.scale);
+            SuperRes superRes(modelsPath, model.algo, model.scale);
+            cv::Mat output, bicubic;
+            superRes.upRes(input, output);
+            cv::resize(input, bicubic, output.size(), 0, 0, cv::INTER_CUBIC);
+            TestUtils::Check(output.cols == input.cols * model.scale && output.rows == input.rows * model.scale,
+                             modelName + " output has wrong size");
+            const double bicubicPsnr = cv::PSNR(output, bicubic);
+            TestUtils::Check(bicubicPsnr >= MIN_BICUBIC_PSNR,
+                             modelName + " is too far from bicubic: " + std::to_string(bicubicPsnr) + " dB");
+
+            const std::filesystem::path goldenPath = goldenDirectory / (modelName + ".png");
+            if (updateGolden)
+            {
+                TestUtils::Check(cv::imwrite(goldenPath.string(), output), "Could not write " + goldenPath.string());
+                std::cout << modelName << ": golden output written" << std::endl;
+                continue;
+            }
+            const cv::Mat golden = cv::imread(goldenPath.string(), cv::IMREAD_COLOR);
+            TestUtils::Check(!golden.empty(), "Golden output missing for " + modelName); // Model added since
+            TestUtils::Check(golden.size() == output.size(), modelName + " golden output has wrong size");
+            const double goldenPsnr = cv::PSNR(output, golden);
+            std::cout << modelName << ": " << goldenPsnr << " dB" << std::endl;
+            TestUtils::Check(goldenPsnr >= MIN_GOLDEN_PSNR,
+                             modelName + " differs from its golden output: " + std::to_string(goldenPsnr) + " dB");
+        }
+    });
+}
@@ -0,0 +1,129 @@
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <map>
+#include <optional>
+#include <functional>
+#include <filesystem>
+#include <opencv2/videoio.hpp>
+#include "MovieUpscaler.h"
+#include "TestUtils.h"
+
+// Frame count and order of whole runs on a synthetic clip, including frame range and early stop
+
+constexpr int FRAME_WIDTH = 320;
+constexpr int FRAME_HEIGHT = 180;
+constexpr size_t CLIP_FRAMES_NUMBER = 30;
+constexpr double CLIP_FPS = 24.0;
+constexpr size_t INSTANCES_NUMBER = 4;
+
+typedef struct
+{
+    std::string inputVideoFilename;
+    std::string outputVideoFilename;
+} TestFiles;
+
+static TestFiles PrepareTestFiles(std::string_view testName)
+{
+    const std::filesystem::path directory = TestUtils::GetTemporaryDirectory(testName);
+    TestFiles testFiles{.inputVideoFilename = (directory / "input.avi").string(),
+                        .outputVideoFilename = (directory / "output.avi").string()};
+    TestUtils::WriteSyntheticClip(testFiles.inputVideoFilename, CLIP_FRAMES_NUMBER,
+                                  cv::Size(FRAME_WIDTH, FRAME_HEIGHT), CLIP_FPS);
+    return testFiles;
+}
+
+static void ConfigureMovieUpscaler(MovieUpscaler &movieUpscaler)
+{
+    movieUpscaler.setSuperresInstancesNumber(INSTANCES_NUMBER);
+    movieUpscaler.getVideoEncoder().setCodec(VideoEncoder::Codec::MJPG); // Built in OpenCV, markers survive it
+    movieUpscaler.getVideoEncoder().setQuality(100);
+}
+
+static void CheckOutputVideo(const std::string &outputVideoFilename, size_t firstIndex, size_t framesNumber,
+                             unsigned short upscaleFactor)
+{
+    cv::VideoCapture outputVideo(outputVideoFilename, cv::CAP_FFMPEG);
+    TestUtils::Check(outputVideo.isOpened(), "Could not open output video " + outputVideoFilename);
+    size_t readFramesNumber = 0;
+    cv::Mat frame;
+    while (outputVideo.read(frame))
+    {
+        const size_t expectedIndex = firstIndex + readFramesNumber;
+        TestUtils::Check(frame.cols == FRAME_WIDTH * upscaleFactor && frame.rows == FRAME_HEIGHT * upscaleFactor,
+                         "Frame " + std::to_string(expectedIndex) + " has wrong size");
+        size_t marker = TestUtils::ReadFrameMarker(frame, cv::Size(FRAME_WIDTH, FRAME_HEIGHT));
+        TestUtils::Check(marker == expectedIndex,
+                         "Frame " + std::to_string(expectedIndex) + " carries marker " + std::to_string(marker));
+        ++readFramesNumber;
+    }
+    TestUtils::Check(readFramesNumber == framesNumber,
+                     "Expected " + std::to_string(framesNumber) + " frames, got " + std::to_string(readFramesNumber));
+}
+
+static void TestRun(const std::string &modelsPath)
+{
+    const TestFiles testFiles = PrepareTestFiles("run");
+    MovieUpscaler movieUpscaler(testFiles.inputVideoFilename, testFiles.outputVideoFilename, 2, modelsPath);
+    ConfigureMovieUpscaler(movieUpscaler);
+    movieUpscaler.run();
+    CheckOutputVideo(testFiles.outputVideoFilename, 0, CLIP_FRAMES_NUMBER, 2);
+}
+
+static void TestHybridRun(const std::string &modelsPath)
+{
+    const TestFiles testFiles = PrepareTestFiles("hybrid-run");
+    MovieUpscaler movieUpscaler(testFiles.inputVideoFilename, testFiles.outputVideoFilename, 2, modelsPath);
+    ConfigureMovieUpscaler(movieUpscaler);
+    movieUpscaler.setHybridDetailThreshold(HybridUpscaler::DEFAULT_DETAIL_THRESHOLD);
+    movieUpscaler.run();
+    CheckOutputVideo(testFiles.outputVideoFilename, 0, CLIP_FRAMES_NUMBER, 2);
+}
+
+static void TestFrameRange(const std::string &modelsPath)
+{
+    constexpr size_t START_FRAME = 10, END_FRAME = 25;
+    const TestFiles testFiles = PrepareTestFiles("frame-range");
+    MovieUpscaler movieUpscaler(testFiles.inputVideoFilename, testFiles.outputVideoFilename, 2, modelsPath);
+    ConfigureMovieUpscaler(movieUpscaler);
+    movieUpscaler.setFrameRange(START_FRAME, END_FRAME);
+    movieUpscaler.run();
+    CheckOutputVideo(testFiles.outputVideoFilename, START_FRAME, END_FRAME - START_FRAME, 2);
+}
+
+static void TestEarlyStop(const std::string &modelsPath)
+{
+    constexpr size_t STOP_FRAME = 12;
+    const TestFiles testFiles = PrepareTestFiles("early-stop");
+    MovieUpscaler movieUpscaler(testFiles.inputVideoFilename, testFiles.outputVideoFilename, 2, modelsPath);
+    ConfigureMovieUpscaler(movieUpscaler);
+    size_t callbacksNumber = 0;
+    movieUpscaler.run([&callbacksNumber](const size_t &frameNumber) -> bool {
+        ++callbacksNumber;
+        return frameNumber < STOP_FRAME;
+    });
+    TestUtils::Check(callbacksNumber == STOP_FRAME + 1,
+                     "Progress callback called " + std::to_string(callbacksNumber) + " times");
+    // Frames already being upscaled when the callback stops the run are still written
+    CheckOutputVideo(testFiles.outputVideoFilename, 0, STOP_FRAME, 2);
+}
+
+int main(int argc, char *argv[])
+{
+    const std::map<std::string_view, std::function<void(const std::string &)>> tests = {
+            {"run",         TestRun},
+            {"hybrid-run",  TestHybridRun},
+            {"frame-range", TestFrameRange},
+            {"early-stop",  TestEarlyStop}
+    };
+    if (argc != 3 || tests.count(argv[2]) == 0)
+    {
+        std::cerr << "Usage: " << argv[0] << " <modelsDirectoryPath> <testName>" << std::endl;
+        return 2;
+    }
+    const std::string modelsPath = argv[1];
+    return TestUtils::RunTest(argv[2], [&]() {
+        tests.at(argv[2])(modelsPath);
+    });
+}
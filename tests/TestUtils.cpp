@@ -0,0 +1,138 @@
+#include <iostream>
+#include <stdexcept>
+#include <exception>
+#include <filesystem>
+#include <vector>
+#include <algorithm>
+#include <opencv2/imgproc.hpp>
+#include <opencv2/videoio.hpp>
+#include "TestUtils.h"
+
+constexpr uint64_t SYNTHETIC_FRAMES_SEED = 0x5eed;
+const cv::Scalar BACKGROUND_COLOR(70, 100, 130);
+constexpr int MARKER_THRESHOLD = 128;
+
+static void DrawFrameMarker(cv::Mat &frame, size_t frameIndex)
+{
+    // One block per bit on a black band, white for 1
+    frame(cv::Rect(0, 0, TestUtils::MARKER_MIN_WIDTH, TestUtils::MARKER_MIN_HEIGHT)).setTo(cv::Scalar::all(0));
+    for (int bit = 0; bit < TestUtils::MARKER_BITS_NUMBER; ++bit)
+    {
+        if ((frameIndex >> bit) & 1U)
+        {
+            frame(cv::Rect((bit + 1) * TestUtils::MARKER_BLOCK_SIZE, TestUtils::MARKER_BLOCK_SIZE,
+                           TestUtils::MARKER_BLOCK_SIZE, TestUtils::MARKER_BLOCK_SIZE)).setTo(cv::Scalar::all(255));
+        }
+    }
+}
+
+static void CheckMarkerFits(const cv::Size &frameSize)
+{
+    if (frameSize.width < TestUtils::MARKER_MIN_WIDTH || frameSize.height < TestUtils::MARKER_MIN_HEIGHT)
+    {
+        throw std::invalid_argument("Synthetic frame is too small for the marker");
+    }
+}
+
+cv::Mat TestUtils::CreateSyntheticFrame(const cv::Size &frameSize, size_t frameIndex)
+{
+    CheckMarkerFits(frameSize);
+    cv::Mat frame(frameSize, CV_8UC3, BACKGROUND_COLOR);
+    cv::RNG rng(SYNTHETIC_FRAMES_SEED); // Same scene for every frame, only moved by the frame index
+    for (int i = 0; i < 12; ++i)
+    {
+        // One draw per statement, arguments evaluation order is unspecified and would differ between compilers
+        const int centerX = rng.uniform(0, frameSize.width);
+        const int centerY = rng.uniform(0, frameSize.height);
+        const int radius = rng.uniform(4, frameSize.height / 4);
+        const int blue = rng.uniform(0, 256);
+        const int green = rng.uniform(0, 256);
+        const int red = rng.uniform(0, 256);
+        cv::circle(frame, cv::Point((centerX + (int) frameIndex * 3) % frameSize.width, centerY), radius,
+                   cv::Scalar(blue, green, red), cv::FILLED, cv::LINE_AA);
+    }
+    cv::putText(frame, std::to_string(frameIndex), cv::Point(MARKER_BLOCK_SIZE, frameSize.height - MARKER_BLOCK_SIZE),
+                cv::FONT_HERSHEY_SIMPLEX, 1.0, cv::Scalar(255, 255, 255), 2, cv::LINE_AA);
+    cv::Mat noise(frameSize, CV_8UC3);
+    cv::RNG noiseRng(SYNTHETIC_FRAMES_SEED + frameIndex); // Film grain like texture, different for each frame
+    noiseRng.fill(noise, cv::RNG::UNIFORM, cv::Scalar::all(0), cv::Scalar::all(24));
+    cv::add(frame, noise, frame);
+    DrawFrameMarker(frame, frameIndex);
+    return frame;
+}
+
+cv::Mat TestUtils::CreateFlatFrame(const cv::Size &frameSize, size_t frameIndex)
+{
+    CheckMarkerFits(frameSize);
+    cv::Mat frame(frameSize, CV_8UC3, BACKGROUND_COLOR);
+    DrawFrameMarker(frame, frameIndex);
+    return frame;
+}
+
+size_t TestUtils::ReadFrameMarker(const cv::Mat &frame, const cv::Size &originalSize)
+{
+    const double scaleX = (double) frame.cols / (double) originalSize.width;
+    const double scaleY = (double) frame.rows / (double) originalSize.height;
+    size_t frameIndex = 0;
+    for (int bit = 0; bit < MARKER_BITS_NUMBER; ++bit)
+    {
+        // Center of the block only, borders are blurred by upscaling and encoding
+        const cv::Rect blockCenter((int) (((bit + 1) * MARKER_BLOCK_SIZE + MARKER_BLOCK_SIZE / 4) * scaleX),
+                                   (int) ((MARKER_BLOCK_SIZE + MARKER_BLOCK_SIZE / 4) * scaleY),
+                                   std::max(1, (int) (MARKER_BLOCK_SIZE / 2 * scaleX)),
+                                   std::max(1, (int) (MARKER_BLOCK_SIZE / 2 * scaleY)));
+        const cv::Scalar blockMean = cv::mean(frame(blockCenter));
+        if ((blockMean[0] + blockMean[1] + blockMean[2]) / 3.0 > MARKER_THRESHOLD)
+        {
+            frameIndex |= (size_t) 1 << bit;
+        }
+    }
+    return frameIndex;
+}
+
+void TestUtils::WriteSyntheticClip(const std::string &filename, size_t framesNumber, const cv::Size &frameSize,
+                                   double fps)
+{
+    cv::VideoWriter videoWriter;
+    if (!videoWriter.open(filename, cv::CAP_OPENCV_MJPEG, cv::VideoWriter::fourcc('M', 'J', 'P', 'G'), fps,
+                          frameSize))
+    {
+        throw std::runtime_error("Could not write synthetic clip " + filename);
+    }
+    videoWriter.set(cv::VIDEOWRITER_PROP_QUALITY, 100); // Built-in MJPEG writer ignores open parameters
+    for (size_t i = 0; i < framesNumber; ++i)
+    {
+        videoWriter.write(CreateSyntheticFrame(frameSize, i));
+    }
+    videoWriter.release();
+}
+
+std::string TestUtils::GetTemporaryDirectory(std::string_view testName)
+{
+    std::filesystem::path directory = std::filesystem::temp_directory_path() / "movie_quality_increase_tests" /
+                                      std::string(testName);
+    std::filesystem::create_directories(directory);
+    return directory.string();
+}
+
+void TestUtils::Check(bool condition, const std::string &message)
+{
+    if (!condition)
+    {
+        throw std::runtime_error(message);
+    }
+}
+
+int TestUtils::RunTest(std::string_view testName, const std::function<void()> &test)
+{
+    try
+    {
+        test();
+    } catch (std::exception const &e)
+    {
+        std::cerr << testName << " failed: " << e.what() << std::endl;
+        return 1;
+    }
+    std::cout << testName << " passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,85 @@
+#ifndef MOVIE_QUALITY_INCREASE_TESTUTILS_H
+#define MOVIE_QUALITY_INCREASE_TESTUTILS_H
+
+#include <string>
+#include <string_view>
+#include <functional>
+#include <opencv2/core.hpp>
+
+class TestUtils
+{
+public:
+    TestUtils() = delete; // Only static helpers
+
+    /**
+     * @brief Create a deterministic synthetic frame, with its index embedded as a marker
+     * @param frameSize Frame size, at least MARKER_MIN_WIDTH x MARKER_MIN_HEIGHT
+     * @param frameIndex Index embedded in the frame, also moves the content so that consecutive frames differ
+     * @return BGR frame
+     */
+    static cv::Mat CreateSyntheticFrame(const cv::Size &frameSize, size_t frameIndex);
+
+    /**
+     * @brief Create a frame without any detail outside its index marker
+     * @param frameSize Frame size, at least MARKER_MIN_WIDTH x MARKER_MIN_HEIGHT
+     * @param frameIndex Index embedded in the frame
+     * @return BGR frame, much faster to upscale than CreateSyntheticFrame() ones in hybrid mode
+     */
+    static cv::Mat CreateFlatFrame(const cv::Size &frameSize, size_t frameIndex);
+
+    /**
+     * @brief Read the index embedded by CreateSyntheticFrame()
+     * @param frame Frame, possibly upscaled and lossy encoded
+     * @param originalSize Size of the frame when the marker was embedded
+     * @return Embedded index
+     */
+    static size_t ReadFrameMarker(const cv::Mat &frame, const cv::Size &originalSize);
+
+    /**
+     * @brief Write a synthetic clip, frame i carrying marker i
+     * @param filename Output filename, should be .avi
+     * @param framesNumber Number of frames
+     * @param frameSize Frames size
+     * @param fps Frames per second
+     * @throw std::runtime_error If the clip could not be written
+     * @note Encoded with MJPG at maximum quality, so that markers survive
+     */
+    static void
+    WriteSyntheticClip(const std::string &filename, size_t framesNumber, const cv::Size &frameSize, double fps);
+
+    /**
+     * @brief Get a directory for temporary test files, created if needed
+     * @param testName Name of the test, used as subdirectory
+     * @return Directory path
+     */
+    static std::string GetTemporaryDirectory(std::string_view testName);
+
+    /**
+     * @brief Throw if a condition is false
+     * @param condition Checked condition
+     * @param message Failure description
+     * @throw std::runtime_error If condition is false
+     */
+    static void Check(bool condition, const std::string &message);
+
+    /**
+     * @brief Run a test, printing its failure
+     * @param testName Name printed on failure
+     * @param test Test function, failing by throwing an exception
+     * @return Process exit code: 0 on success, 1 on failure
+     */
+    static int RunTest(std::string_view testName, const std::function<void()> &test);
+
+    static constexpr int MARKER_BITS_NUMBER = 16;
+
+    static constexpr int MARKER_BLOCK_SIZE = 16; // Original frame pixels, big enough to survive lossy encoding
+
+    static constexpr int MARKER_MIN_WIDTH = (MARKER_BITS_NUMBER + 2) * MARKER_BLOCK_SIZE;
+
+    static constexpr int MARKER_MIN_HEIGHT = 3 * MARKER_BLOCK_SIZE;
+
+    static constexpr int SKIP_RETURN_CODE = 77; // Reported as skipped by ctest, see SKIP_RETURN_CODE test property
+};
+
+
+#endif //MOVIE_QUALITY_INCREASE_TESTUTILS_H
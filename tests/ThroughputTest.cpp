@@ -0,0 +1,121 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <unistd.h>
+#include "FrameUpscaler.h"
+#include "TestUtils.h"
+
+// Upscale throughput, compared to a baseline measured earlier on the same machine, baselines are keyed by hostname
+// Skipped on machines without a baseline, set MOVIE_QUALITY_INCREASE_UPDATE_BASELINE=1 to record it
+
+constexpr int FRAME_WIDTH = 640;
+constexpr int FRAME_HEIGHT = 360;
+constexpr unsigned short UPSCALE_FACTOR = 2;
+constexpr size_t FRAMES_NUMBER = 96;
+constexpr std::string_view SCENARIO_NAME = "espcn_x2_640x360";
+constexpr std::string_view UPDATE_BASELINE_VARIABLE = "MOVIE_QUALITY_INCREASE_UPDATE_BASELINE";
+
+static std::string GetMachineName()
+{
+    std::vector<char> hostname(256, '\0');
+    if (gethostname(hostname.data(), hostname.size() - 1) != 0)
+    {
+        return "unknown";
+    }
+    return hostname.data();
+}
+
+static std::map<std::string, double> ReadBaselines(const std::string &baselineFilename)
+{
+    std::map<std::string, double> baselines; // "machine scenario" -> frames per second
+    std::ifstream baselineFile(baselineFilename);
+    std::string machine, scenario;
+    double framesPerSecond;
+    while (baselineFile >> machine >> scenario >> framesPerSecond)
+    {
+        baselines[machine + " " + scenario] = framesPerSecond;
+    }
+    return baselines;
+}
+
+static void WriteBaselines(const std::string &baselineFilename, const std::map<std::string, double> &baselines)
+{
+    const std::filesystem::path baselineDirectory = std::filesystem::path(baselineFilename).parent_path();
+    if (!baselineDirectory.empty())
+    {
+        std::filesystem::create_directories(baselineDirectory);
+    }
+    std::ofstream baselineFile(baselineFilename, std::ios::trunc);
+    for (const auto &[key, framesPerSecond]: baselines)
+    {
+        baselineFile << key << " " << framesPerSecond << std::endl;
+    }
+    TestUtils::Check(baselineFile.good(), "Could not write " + baselineFilename);
+}
+
+static double MeasureThroughput(const std::string &modelsPath)
+{
+    std::vector<cv::Mat> frames;
+    for (size_t i = 0; i < FRAMES_NUMBER; ++i)
+    {
+        frames.push_back(TestUtils::CreateSyntheticFrame(cv::Size(FRAME_WIDTH, FRAME_HEIGHT), i));
+    }
+    FrameUpscaler frameUpscaler(modelsPath, UPSCALE_FACTOR);
+    size_t upscaledFramesNumber = 0;
+    frameUpscaler.setOutputCallback([&upscaledFramesNumber](FrameUpscaler::UpscaledFrame &&) {
+        ++upscaledFramesNumber;
+    });
+    frameUpscaler.warmUp(cv::Size(FRAME_WIDTH, FRAME_HEIGHT)); // Steady state only
+    auto beginTime = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < FRAMES_NUMBER; ++i)
+    {
+        frameUpscaler.push(std::move(frames[i]), (int64_t) i);
+    }
+    frameUpscaler.finish();
+    std::chrono::duration<double> duration = std::chrono::steady_clock::now() - beginTime;
+    TestUtils::Check(upscaledFramesNumber == FRAMES_NUMBER, "Some frames were not upscaled");
+    return (double) FRAMES_NUMBER / duration.count();
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc != 4)
+    {
+        std::cerr << "Usage: " << argv[0] << " <modelsDirectoryPath> <baselineFile> <tolerancePercent>" << std::endl;
+        return 2;
+    }
+    const std::string modelsPath = argv[1];
+    const std::string baselineFilename = argv[2];
+    const double tolerancePercent = std::stod(argv[3]);
+    const bool updateBaseline = std::getenv(UPDATE_BASELINE_VARIABLE.data()) != nullptr;
+    const std::string baselineKey = GetMachineName() + " " + std::string(SCENARIO_NAME);
+    std::map<std::string, double> baselines = ReadBaselines(baselineFilename);
+    if (baselines.count(baselineKey) == 0 && !updateBaseline)
+    {
+        std::cout << "No baseline for \"" << baselineKey << "\" in " << baselineFilename << ", run with "
+                  << UPDATE_BASELINE_VARIABLE << "=1 on an idle machine to record it" << std::endl;
+        return TestUtils::SKIP_RETURN_CODE;
+    }
+    return TestUtils::RunTest("throughput", [&]() {
+        const double framesPerSecond = MeasureThroughput(modelsPath);
+        std::cout << SCENARIO_NAME << ": " << framesPerSecond << " fps" << std::endl;
+        if (updateBaseline)
+        {
+            baselines[baselineKey] = framesPerSecond;
+            WriteBaselines(baselineFilename, baselines);
+            std::cout << "Baseline recorded in " << baselineFilename << std::endl;
+            return;
+        }
+        const double minFramesPerSecond = baselines.at(baselineKey) * (1.0 - tolerancePercent / 100.0);
+        std::cout << "Baseline: " << baselines.at(baselineKey) << " fps, minimum: " << minFramesPerSecond << " fps"
+                  << std::endl;
+        TestUtils::Check(framesPerSecond >= minFramesPerSecond,
+                         "Throughput dropped more than " + std::to_string(tolerancePercent) + "% below the baseline");
+    });
+}